@@ -0,0 +1,96 @@
+// Benchmark for game snapshots.
+//
+// Runs a game in an arena of growing size, gives every player a score,
+// and times what a snapshot tick spends on the room: encoding the room and
+// its game into a record, which happens on the event loop. Restoring the
+// record into a fresh room and game, done once at startup, is timed too.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include "../server/player_directory.h"
+#include "../server/room_manager.h"
+#include "../server/question_manager.h"
+#include "../server/game_engine.h"
+#include "../server/game_snapshot.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    const int ENCODE_RUNS = 20;
+
+    double microsecondsSince(Clock::time_point start, int runs = 1) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        return static_cast<double>(elapsed) / 1000.0 / runs;
+    }
+
+    bool timeArena(QuestionManager& questions, int players) {
+        std::cout.setstate(std::ios::failbit);
+        PlayerDirectory directory;
+        RoomManager rooms(directory);
+        rooms.setArenaCapacity(players);
+        GameEngine engine(rooms, questions, directory);
+        PlayerId host = directory.intern("player0");
+        int roomId = rooms.createRoom("arena", host, RoomKind::ARENA);
+        for (int i = 1; i < players; ++i) {
+            rooms.joinRoom(roomId, directory.intern("player" + std::to_string(i)));
+        }
+        if (engine.startGame(roomId, host, 10).rfind("GAME_STARTED", 0) != 0) {
+            std::cout.clear();
+            std::cerr << "Could not start a game with " << players << " players" << std::endl;
+            return false;
+        }
+        for (PlayerId player : rooms.getRoomPlayers(roomId)) {
+            engine.submitAnswer(roomId, player, 1 + static_cast<int>(player % 4));
+        }
+
+        std::string record;
+        Clock::time_point start = Clock::now();
+        for (int run = 0; run < ENCODE_RUNS; ++run) {
+            record.clear();
+            SnapshotEncoder out(record);
+            rooms.saveRoom(roomId, out);
+            engine.saveGame(roomId, out);
+        }
+        double encodeUs = microsecondsSince(start, ENCODE_RUNS);
+
+        RoomManager restoredRooms(directory);
+        GameEngine restoredEngine(restoredRooms, questions, directory);
+        start = Clock::now();
+        SnapshotDecoder in(record);
+        bool restored = restoredRooms.restoreRoom(roomId, in, directory)
+                        && restoredEngine.restoreGame(roomId, in, directory) && in.atEnd();
+        double restoreUs = microsecondsSince(start);
+        std::cout.clear();
+        if (!restored || restoredEngine.getLeaderboard(roomId, host) != engine.getLeaderboard(roomId, host)) {
+            std::cerr << "Restored game with " << players << " players does not match the original" << std::endl;
+            return false;
+        }
+        std::cout << std::setw(10) << players << std::setw(14) << record.size() << std::fixed << std::setprecision(0)
+                  << std::setw(13) << encodeUs << std::setw(14) << restoreUs << std::endl;
+        std::cout.setstate(std::ios::failbit);
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int maxPlayers = 100000;
+    if (argc > 1) {
+        maxPlayers = std::atoi(argv[1]);
+    }
+    std::cout.setstate(std::ios::failbit);   // silence the managers' logging
+    QuestionManager questions("data/questions.txt");
+    std::cout.clear();
+
+    std::cout << std::setw(10) << "players" << std::setw(14) << "record(bytes)" << std::setw(13) << "encode(us)"
+              << std::setw(14) << "restore(us)" << std::endl;
+    for (int players = 100; players <= maxPlayers; players *= 10) {
+        if (!timeArena(questions, players)) {
+            return 1;
+        }
+    }
+    std::cout.clear();
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Benchmark for QuestionManager::getRandomQuestions.
+//
+// Builds question banks of growing size and times how long picking one
+// game's worth of questions takes. The bank's sampler should stay flat as
+// the bank grows; the full-shuffle approach it replaced is timed alongside
+// for comparison.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "../server/question_manager.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    const int QUESTIONS_PER_GAME = 10;
+
+    bool writeBank(const std::string& path, size_t size) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            return false;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            file << "Question " << i << "?|A|B|C|D|" << (i + 1) << " " << (i % 4) << "\n";
+        }
+        return file.good();
+    }
+
+    double nanosecondsPerCall(Clock::time_point start, int calls) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        return static_cast<double>(elapsed) / calls;
+    }
+
+    // The old sampler: shuffle an index over the whole bank, keep the first few
+    double timeFullShuffle(size_t bankSize, int calls) {
+        std::mt19937 rng(12345);
+        volatile int sink = 0;   // keeps the shuffles from being optimized away
+        Clock::time_point start = Clock::now();
+        for (int call = 0; call < calls; ++call) {
+            std::vector<int> indices(bankSize);
+            std::iota(indices.begin(), indices.end(), 0);
+            std::shuffle(indices.begin(), indices.end(), rng);
+            sink = indices[0];
+        }
+        (void)sink;
+        return nanosecondsPerCall(start, calls);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxBank = 1000000;
+    if (argc > 1) {
+        maxBank = std::strtoul(argv[1], nullptr, 10);
+    }
+    std::string path = "/tmp/question_sampling_bench_" + std::to_string(getpid()) + ".txt";
+
+    std::cout << std::setw(10) << "bank" << std::setw(16) << "sample(ns)" << std::setw(20) << "full shuffle(ns)"
+              << std::endl;
+    for (size_t bankSize = 1000; bankSize <= maxBank; bankSize *= 10) {
+        if (!writeBank(path, bankSize)) {
+            std::cerr << "Could not write " << path << std::endl;
+            return 1;
+        }
+        double sampleNs = 0;
+        {
+            std::cout.setstate(std::ios::failbit);   // silence the manager's logging
+            QuestionManager bank(path);
+            std::cout.clear();
+            if (bank.getQuestionCount() != static_cast<int>(bankSize)) {
+                std::cerr << "Loaded " << bank.getQuestionCount() << " of " << bankSize << " questions" << std::endl;
+                return 1;
+            }
+            bank.getRandomQuestions(QUESTIONS_PER_GAME);   // first call builds the permutation
+            const int calls = 100000;
+            Clock::time_point start = Clock::now();
+            for (int call = 0; call < calls; ++call) {
+                if (bank.getRandomQuestions(QUESTIONS_PER_GAME).size() != QUESTIONS_PER_GAME) {
+                    std::cerr << "Short sample" << std::endl;
+                    return 1;
+                }
+            }
+            sampleNs = nanosecondsPerCall(start, calls);
+            std::cout.setstate(std::ios::failbit);
+        }
+        std::cout.clear();
+        std::remove(path.c_str());
+
+        int shuffleCalls = static_cast<int>(std::max<size_t>(3, 20000000 / bankSize / 10));
+        double shuffleNs = timeFullShuffle(bankSize, shuffleCalls);
+        std::cout << std::setw(10) << bankSize << std::fixed << std::setprecision(0)
+                  << std::setw(16) << sampleNs << std::setw(20) << shuffleNs << std::endl;
+    }
+    return 0;
+}
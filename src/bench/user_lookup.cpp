@@ -0,0 +1,190 @@
+// Benchmark for the user directory behind REGISTER and LOGIN.
+//
+// Fills directories of growing size and times the lookups the auth path
+// makes: inserting a new account (register), finding an existing one
+// (login) and probing for a free name (the register existence check).
+// UserTable should stay flat as the directory grows; the std::map it
+// replaced is timed alongside for comparison. At the largest size the
+// same lookups also go through AuthenticationManager, loaded from a file,
+// and registerUser and login are timed end to end. Those hash at the
+// smallest scrypt cost so the lock, log append and interning show through;
+// the hash alone is timed at that cost too, since it does not depend on
+// user count.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "../server/user_table.h"
+#include "../server/authentication.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    const int LOOKUPS = 1000000;
+    const int AUTH_CALLS = 10000;
+    const int BENCH_HASH_LOG_N = 1;
+
+    std::string nameOf(size_t i) {
+        return "user" + std::to_string(i);
+    }
+
+    double nanosecondsPerCall(Clock::time_point start, size_t calls) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        return static_cast<double>(elapsed) / static_cast<double>(calls);
+    }
+
+    double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    struct Timings {
+        double insertNs;
+        double hitNs;
+        double missNs;
+    };
+
+    // Lookup keys are prepared up front so only the lookups are timed
+    void makeKeys(size_t users, std::vector<std::string>& hits, std::vector<std::string>& misses) {
+        std::mt19937 rng(12345);
+        hits.clear();
+        misses.clear();
+        for (int i = 0; i < LOOKUPS; ++i) {
+            hits.push_back(nameOf(rng() % users));
+            misses.push_back("free" + std::to_string(rng()));
+        }
+    }
+
+    Timings timeUserTable(size_t users, const std::vector<std::string>& hits, const std::vector<std::string>& misses) {
+        Timings timings;
+        UserTable table;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < users; ++i) {
+            table.insert(User(nameOf(i), "password"));
+        }
+        timings.insertNs = nanosecondsPerCall(start, users);
+        size_t found = 0;
+        start = Clock::now();
+        for (const std::string& name : hits) found += table.find(name) != nullptr;
+        timings.hitNs = nanosecondsPerCall(start, hits.size());
+        start = Clock::now();
+        for (const std::string& name : misses) found += table.find(name) != nullptr;
+        timings.missNs = nanosecondsPerCall(start, misses.size());
+        if (found != hits.size()) {
+            std::cerr << "UserTable found " << found << " of " << hits.size() << " users" << std::endl;
+            std::exit(1);
+        }
+        return timings;
+    }
+
+    // The old directory
+    Timings timeMap(size_t users, const std::vector<std::string>& hits, const std::vector<std::string>& misses) {
+        Timings timings;
+        std::map<std::string, User> map;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < users; ++i) {
+            std::string name = nameOf(i);
+            map[name] = User(name, "password");
+        }
+        timings.insertNs = nanosecondsPerCall(start, users);
+        volatile size_t found = 0;   // keeps the lookups from being optimized away
+        start = Clock::now();
+        for (const std::string& name : hits) found = found + (map.find(name) != map.end());
+        timings.hitNs = nanosecondsPerCall(start, hits.size());
+        start = Clock::now();
+        for (const std::string& name : misses) found = found + (map.find(name) != map.end());
+        timings.missNs = nanosecondsPerCall(start, misses.size());
+        return timings;
+    }
+
+    bool timeAuthenticationManager(size_t users, const std::vector<std::string>& hits,
+                                   const std::vector<std::string>& misses) {
+        std::string path = "/tmp/user_lookup_bench_" + std::to_string(getpid()) + ".txt";
+        {
+            std::ofstream file(path);
+            for (size_t i = 0; i < users; ++i) {
+                file << nameOf(i) << " password -1 0 0\n";
+            }
+            if (!file.good()) {
+                std::cerr << "Could not write " << path << std::endl;
+                return false;
+            }
+        }
+        bool ok = true;
+        {
+            std::cout.setstate(std::ios::failbit);   // silence the manager's logging
+            Clock::time_point start = Clock::now();
+            AuthenticationManager auth(path, BENCH_HASH_LOG_N);
+            double loadMs = millisecondsSince(start);
+            std::cout.clear();
+
+            size_t found = 0;
+            start = Clock::now();
+            for (const std::string& name : hits) found += auth.userExists(name);
+            double hitNs = nanosecondsPerCall(start, hits.size());
+            start = Clock::now();
+            for (const std::string& name : misses) found += auth.userExists(name);
+            double missNs = nanosecondsPerCall(start, misses.size());
+            ok = found == hits.size() && auth.getUserCount() == static_cast<int>(users);
+            std::cout << "AuthenticationManager with " << users << " users: load " << std::fixed << std::setprecision(0)
+                      << loadMs << " ms, userExists hit " << hitNs << " ns, miss " << missNs << " ns" << std::endl;
+
+            std::vector<std::string> fresh;
+            for (int i = 0; i < AUTH_CALLS; ++i) {
+                fresh.push_back("fresh" + std::to_string(i));
+            }
+            start = Clock::now();
+            for (int i = 0; i < AUTH_CALLS; ++i) hashPassword("password", BENCH_HASH_LOG_N);
+            double hashNs = nanosecondsPerCall(start, AUTH_CALLS);
+            std::cout.setstate(std::ios::failbit);
+            size_t succeeded = 0;
+            start = Clock::now();
+            for (const std::string& name : fresh) succeeded += auth.registerUser(name, "password");
+            double registerNs = nanosecondsPerCall(start, fresh.size());
+            start = Clock::now();
+            for (const std::string& name : fresh) succeeded += auth.login(name, "password") != INVALID_PLAYER_ID;
+            double loginNs = nanosecondsPerCall(start, fresh.size());
+            auth.saveUsersToFile();
+            std::cout.clear();
+            ok = ok && succeeded == 2 * fresh.size();
+            std::cout << "registerUser " << registerNs << " ns, login " << loginNs << " ns (hash alone at log2 N = "
+                      << BENCH_HASH_LOG_N << ": " << hashNs << " ns)" << std::endl;
+            std::cout.setstate(std::ios::failbit);
+        }
+        std::cout.clear();
+        std::remove(path.c_str());
+        std::remove((path + ".log").c_str());
+        if (!ok) {
+            std::cerr << "AuthenticationManager lookups, registrations or logins did not match the user file" << std::endl;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxUsers = 1000000;
+    if (argc > 1) {
+        maxUsers = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    std::cout << std::setw(10) << "users" << std::setw(12) << "insert(ns)" << std::setw(10) << "hit(ns)"
+              << std::setw(11) << "miss(ns)" << std::setw(16) << "map insert(ns)" << std::setw(13) << "map hit(ns)"
+              << std::setw(14) << "map miss(ns)" << std::endl;
+    std::vector<std::string> hits, misses;
+    for (size_t users = 1000; users <= maxUsers; users *= 10) {
+        makeKeys(users, hits, misses);
+        Timings table = timeUserTable(users, hits, misses);
+        Timings map = timeMap(users, hits, misses);
+        std::cout << std::setw(10) << users << std::fixed << std::setprecision(0)
+                  << std::setw(12) << table.insertNs << std::setw(10) << table.hitNs << std::setw(11) << table.missNs
+                  << std::setw(16) << map.insertNs << std::setw(13) << map.hitNs << std::setw(14) << map.missNs << std::endl;
+    }
+    makeKeys(maxUsers, hits, misses);
+    return timeAuthenticationManager(maxUsers, hits, misses) ? 0 : 1;
+}
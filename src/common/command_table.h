@@ -0,0 +1,95 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <string_view>
+#include <array>
+#include <cstddef>
+
+enum class CommandId : unsigned char {
+    REGISTER,
+    LOGIN,
+    CREATE_ROOM,
+    JOIN_ROOM,
+    BROWSE_ROOMS,
+    START_GAME,
+    END_GAME,
+    GET_CURRENT_QUESTION,
+    SUBMIT_ANSWER,
+    GET_GAME_INFO,
+    GET_LEADERBOARD,
+    QUIT,
+    RESUME,
+    COUNT,
+    UNKNOWN = COUNT
+};
+
+// Compile-time perfect hash from command names to CommandId. A lookup is
+// one hash, one table load and one string compare.
+namespace CommandTable {
+    constexpr size_t COMMAND_COUNT = static_cast<size_t>(CommandId::COUNT);
+    constexpr size_t SLOT_COUNT = 32;
+
+    // Indexed by CommandId
+    constexpr std::array<std::string_view, COMMAND_COUNT> NAMES = {
+        "REGISTER",
+        "LOGIN",
+        "CREATE_ROOM",
+        "JOIN_ROOM",
+        "BROWSE_ROOMS",
+        "START_GAME",
+        "END_GAME",
+        "GET_CURRENT_QUESTION",
+        "SUBMIT_ANSWER",
+        "GET_GAME_INFO",
+        "GET_LEADERBOARD",
+        "QUIT",
+        "RESUME"
+    };
+
+    // First byte, last byte and length are enough to separate every command
+    constexpr size_t hash(std::string_view name) {
+        return (static_cast<unsigned char>(name.front())
+                + 2u * static_cast<unsigned char>(name.back())
+                + 13u * name.size()) & (SLOT_COUNT - 1);
+    }
+
+    constexpr std::array<CommandId, SLOT_COUNT> buildSlots() {
+        std::array<CommandId, SLOT_COUNT> slots{};
+        for (size_t i = 0; i < SLOT_COUNT; ++i) {
+            slots[i] = CommandId::UNKNOWN;
+        }
+        for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+            slots[hash(NAMES[i])] = static_cast<CommandId>(i);
+        }
+        return slots;
+    }
+
+    constexpr bool isCollisionFree() {
+        std::array<bool, SLOT_COUNT> used{};
+        for (size_t i = 0; i < COMMAND_COUNT; ++i) {
+            size_t slot = hash(NAMES[i]);
+            if (used[slot]) {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    static_assert(isCollisionFree(), "Command names collide in CommandTable::hash; adjust its constants");
+
+    constexpr std::array<CommandId, SLOT_COUNT> SLOTS = buildSlots();
+
+    constexpr CommandId lookup(std::string_view name) {
+        if (name.empty()) {
+            return CommandId::UNKNOWN;
+        }
+        CommandId id = SLOTS[hash(name)];
+        if (id == CommandId::UNKNOWN || NAMES[static_cast<size_t>(id)] != name) {
+            return CommandId::UNKNOWN;
+        }
+        return id;
+    }
+}
+
+#endif
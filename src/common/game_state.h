@@ -6,10 +6,16 @@
 // Game constants
 namespace GameConstants {
     const int MAX_PLAYERS_PER_ROOM = 10;
+    const int DEFAULT_ARENA_CAPACITY = 10000;   // overridden with --arena-capacity
+    const int ARENA_LEADERBOARD_SIZE = 10;      // arena leaderboards list the top N plus the reader
     const int MIN_PLAYERS_TO_START = 2;
     const int POINTS_PER_CORRECT_ANSWER = 10;
     const int QUESTION_TIME_LIMIT_SECONDS = 30;
+    const int DEFAULT_RESUME_GRACE_SECONDS = 60;   // overridden with --resume-grace
+    const int DEFAULT_SNAPSHOT_INTERVAL_MS = 1000;   // overridden with --snapshot-interval
     const int MAX_QUESTIONS_PER_GAME = 10;
+    const int MAX_MESSAGE_LENGTH = 4096;   // longest protocol line the server accepts
+    const int MAX_OUTPUT_QUEUE_BYTES = 1024 * 1024;   // clients further behind than this are dropped
     const int DEFAULT_PORT = 8080;
     const std::string DEFAULT_HOST = "127.0.0.1";
 }
@@ -34,12 +40,16 @@ namespace ErrorMessages {
     const std::string GAME_ALREADY_STARTED = "Game already in progress";
     const std::string NOT_ENOUGH_PLAYERS = "Not enough players to start";
     const std::string NOT_HOST = "Only the host can perform this action";
+    const std::string SERVER_BUSY = "Server busy, try again";
+    const std::string SESSION_EXPIRED = "Session expired, please log in";
+    const std::string ACCOUNT_NOT_SAVED = "Account could not be saved, try again later";
 }
 
 // Success messages
 namespace SuccessMessages {
     const std::string REGISTRATION_SUCCESS = "Registration successful";
     const std::string LOGIN_SUCCESS = "Login successful";
+    const std::string SESSION_RESUMED = "Session resumed";
     const std::string ROOM_CREATED = "Room created successfully";
     const std::string ROOM_JOINED = "Joined room successfully";
     const std::string GAME_STARTED = "Game started successfully";
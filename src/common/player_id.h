@@ -0,0 +1,11 @@
+#ifndef PLAYER_ID_H
+#define PLAYER_ID_H
+
+#include <cstdint>
+
+// Dense integer handle for a username. Ids are handed out at login, never
+// reused, and stay valid for the life of the server.
+typedef uint32_t PlayerId;
+const PlayerId INVALID_PLAYER_ID = 0xFFFFFFFFu;
+
+#endif
@@ -1,29 +1,91 @@
 #include "protocol.h"
-#include <sstream>
+#include <charconv>
+
+namespace {
+
+// Calls fn for each '|'-separated field. Like std::getline, a trailing
+// separator does not produce an empty last field.
+template <typename Fn>
+void forEachField(std::string_view message, Fn&& fn) {
+    size_t pos = 0;
+    while (pos < message.size()) {
+        size_t bar = message.find('|', pos);
+        if (bar == std::string_view::npos) {
+            fn(message.substr(pos));
+            return;
+        }
+        fn(message.substr(pos, bar - pos));
+        pos = bar + 1;
+    }
+}
+
+} // namespace
+
+MessageAppender::MessageAppender(std::string& buffer, std::string_view command) : out(buffer) {
+    out.append(command.data(), command.size());
+}
+
+MessageAppender& MessageAppender::add(std::string_view param) {
+    out.push_back('|');
+    out.append(param.data(), param.size());
+    return *this;
+}
+
+MessageAppender& MessageAppender::add(int value) {
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.push_back('|');
+    out.append(digits, result.ptr - digits);
+    return *this;
+}
 
 // Builds a protocol message from command and parameters
 std::string buildMessage(const std::string& command, const std::vector<std::string>& params) {
-    std::ostringstream oss;
-    oss << command;
+    size_t length = command.size();
     for (const auto& param : params) {
-        oss << '|' << param;
+        length += param.size() + 1;
     }
-    return oss.str();
+    std::string result;
+    result.reserve(length);
+    MessageAppender message(result, command);
+    for (const auto& param : params) {
+        message.add(param);
+    }
+    return result;
 }
 
 // Parses a protocol message into command and parameters
 ProtocolMessage parseMessage(const std::string& message) {
     ProtocolMessage result;
-    std::istringstream iss(message);
-    std::string token;
     bool first = true;
-    while (std::getline(iss, token, '|')) {
+    forEachField(message, [&](std::string_view field) {
         if (first) {
-            result.command = token;
+            result.command.assign(field.data(), field.size());
             first = false;
         } else {
-            result.params.push_back(token);
+            result.params.emplace_back(field);
         }
-    }
+    });
+    return result;
+}
+
+// Tokenizes a message in place, without copying or allocating
+ProtocolMessageView parseMessageView(std::string_view message) {
+    ProtocolMessageView result;
+    bool first = true;
+    forEachField(message, [&](std::string_view field) {
+        if (first) {
+            result.command = field;
+            first = false;
+        } else if (result.paramCount < ProtocolMessageView::MAX_PARAMS) {
+            result.params[result.paramCount++] = field;
+        }
+    });
     return result;
 }
+
+bool parseIntField(std::string_view field, int& value) {
+    const char* end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
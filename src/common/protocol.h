@@ -2,7 +2,10 @@
 #define PROTOCOL_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <array>
+#include <cstddef>
 
 
 struct ProtocolMessage {
@@ -10,10 +13,40 @@ struct ProtocolMessage {
     std::vector<std::string> params;
 };
 
+// Allocation-free view of a message. The fields point into the parsed text
+// and are only valid while it is; parameters past MAX_PARAMS are dropped.
+struct ProtocolMessageView {
+    static const size_t MAX_PARAMS = 16;
+
+    std::string_view command;
+    std::array<std::string_view, MAX_PARAMS> params;
+    size_t paramCount = 0;
+
+    size_t size() const { return paramCount; }
+    std::string_view operator[](size_t i) const { return params[i]; }
+};
+
+// Appends "COMMAND|param1|...|paramN" to an existing buffer, e.g. a
+// connection's output queue, without intermediate strings.
+class MessageAppender {
+public:
+    MessageAppender(std::string& out, std::string_view command);
+
+    MessageAppender& add(std::string_view param);
+    MessageAppender& add(int value);
+
+private:
+    std::string& out;
+};
+
 
 std::string buildMessage(const std::string& command, const std::vector<std::string>& params);
 
 
 ProtocolMessage parseMessage(const std::string& message);
+ProtocolMessageView parseMessageView(std::string_view message);
+
+// Strict decimal parse of a whole field; false on empty, junk or overflow
+bool parseIntField(std::string_view field, int& value);
 
 #endif 
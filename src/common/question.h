@@ -3,12 +3,17 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 struct Question {
     int questionId;
     std::string questionText;
     std::vector<std::string> options;  
     int correctAnswerIndex;  
+    // Fixed parts of the QUESTION wire frame, encoded once by the server's
+    // question bank: "|text|" and "|1.option|2.option|...\n"
+    std::shared_ptr<const std::string> textSegment;
+    std::shared_ptr<const std::string> optionsSegment;
 
     Question() : questionId(-1), correctAnswerIndex(-1) {}
     Question(int id, const std::string& text, const std::vector<std::string>& opts, int correct)
@@ -16,12 +21,13 @@ struct Question {
 
     
     int getQuestionId() const { return questionId; }
-    std::string getQuestionText() const { return questionText; }
-    std::vector<std::string> getOptions() const { return options; }
+    const std::string& getQuestionText() const { return questionText; }
+    const std::vector<std::string>& getOptions() const { return options; }
     int getCorrectAnswerIndex() const { return correctAnswerIndex; }
-    std::string getCorrectAnswer() const { 
+    const std::string& getCorrectAnswer() const { 
+        static const std::string none;
         return (correctAnswerIndex >= 0 && correctAnswerIndex < static_cast<int>(options.size())) 
-               ? options[correctAnswerIndex] : ""; 
+               ? options[correctAnswerIndex] : none; 
     }
 
     
@@ -33,4 +39,8 @@ struct Question {
     int getOptionCount() const { return static_cast<int>(options.size()); }
 };
 
+// Questions are immutable once loaded; the bank and every running game
+// share them through these handles instead of copying the strings
+typedef std::shared_ptr<const Question> QuestionHandle;
+
 #endif 
\ No newline at end of file
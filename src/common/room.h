@@ -3,9 +3,10 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <algorithm>
 #include "user.h"
+#include "player_id.h"
 
 enum class GameState {
     WAITING,     
@@ -13,62 +14,77 @@ enum class GameState {
     FINISHED    
 };
 
+enum class RoomKind {
+    STANDARD,   // up to GameConstants::MAX_PLAYERS_PER_ROOM players
+    ARENA       // large live games; capacity set by the server
+};
+
 struct Room {
     int roomId;
     std::string roomName;
-    std::string hostUsername;
-    std::vector<std::string> players;  
-    std::map<std::string, int> playerScores;
+    PlayerId hostId;
+    std::vector<PlayerId> players;
+    std::unordered_map<PlayerId, size_t> playerSlots;   // position of each player in players
+    RoomKind kind;
+    int capacity;
     int currentQuestionIndex;
     int totalQuestions;
     GameState gameState;
 
-    Room() : roomId(-1), currentQuestionIndex(-1), totalQuestions(0), gameState(GameState::WAITING) {}
-    Room(int id, const std::string& name, const std::string& host)
-        : roomId(id), roomName(name), hostUsername(host), currentQuestionIndex(-1), 
+    Room() : roomId(-1), hostId(INVALID_PLAYER_ID), kind(RoomKind::STANDARD), capacity(0), currentQuestionIndex(-1),
+             totalQuestions(0), gameState(GameState::WAITING) {}
+    Room(int id, const std::string& name, PlayerId host, RoomKind roomKind, int maxPlayers)
+        : roomId(id), roomName(name), hostId(host), kind(roomKind), capacity(maxPlayers), currentQuestionIndex(-1), 
           totalQuestions(0), gameState(GameState::WAITING) {}
 
     int getRoomId() const { return roomId; }
     std::string getRoomName() const { return roomName; }
-    std::string getHostUsername() const { return hostUsername; }
-    std::vector<std::string> getPlayers() const { return players; }
+    PlayerId getHostId() const { return hostId; }
+    const std::vector<PlayerId>& getPlayers() const { return players; }
+    RoomKind getKind() const { return kind; }
+    bool isArena() const { return kind == RoomKind::ARENA; }
+    int getCapacity() const { return capacity; }
+    bool isFull() const { return getPlayerCount() >= capacity; }
     int getCurrentQuestionIndex() const { return currentQuestionIndex; }
     int getTotalQuestions() const { return totalQuestions; }
     GameState getGameState() const { return gameState; }
 
     // Player management
-    void addPlayer(const std::string& username) {
-        if (std::find(players.begin(), players.end(), username) == players.end()) {
-            players.push_back(username);
-            playerScores[username] = 0;
+    void addPlayer(PlayerId player) {
+        if (playerSlots.emplace(player, players.size()).second) {
+            players.push_back(player);
         }
     }
 
-    void removePlayer(const std::string& username) {
-        players.erase(std::remove(players.begin(), players.end(), username), players.end());
-        playerScores.erase(username);
+    // Standard rooms keep join order, which decides the next host. Arenas
+    // move the last player into the gap so leaving stays O(1).
+    void removePlayer(PlayerId player) {
+        auto it = playerSlots.find(player);
+        if (it == playerSlots.end()) {
+            return;
+        }
+        size_t slot = it->second;
+        playerSlots.erase(it);
+        if (kind == RoomKind::ARENA) {
+            players[slot] = players.back();
+            players.pop_back();
+            if (slot < players.size()) {
+                playerSlots[players[slot]] = slot;
+            }
+        } else {
+            players.erase(players.begin() + slot);
+            for (size_t i = slot; i < players.size(); ++i) {
+                playerSlots[players[i]] = i;
+            }
+        }
     }
 
-    bool hasPlayer(const std::string& username) const {
-        return std::find(players.begin(), players.end(), username) != players.end();
+    bool hasPlayer(PlayerId player) const {
+        return playerSlots.find(player) != playerSlots.end();
     }
 
     int getPlayerCount() const { return static_cast<int>(players.size()); }
 
-    // Score management
-    void setPlayerScore(const std::string& username, int score) {
-        playerScores[username] = score;
-    }
-
-    void addPlayerScore(const std::string& username, int points) {
-        playerScores[username] += points;
-    }
-
-    int getPlayerScore(const std::string& username) const {
-        auto it = playerScores.find(username);
-        return (it != playerScores.end()) ? it->second : 0;
-    }
-
     // Game state management
     void setGameState(GameState state) { gameState = state; }
     void setCurrentQuestionIndex(int index) { currentQuestionIndex = index; }
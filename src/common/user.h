@@ -20,6 +20,7 @@ struct User {
     int getScore() const { return score; }
     bool getIsAdmin() const { return isAdmin; }
 
+    void setPassword(const std::string& pwd) { password = pwd; }
     void setCurrentRoomId(int roomId) { currentRoomId = roomId; }
     void setScore(int newScore) { score = newScore; }
     void setIsAdmin(bool admin) { isAdmin = admin; }
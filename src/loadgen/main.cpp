@@ -0,0 +1,543 @@
+// Headless load generator: drives many scripted players against the quiz
+// server over a few epoll threads and reports per-command latency.
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include "../common/protocol.h"
+#include "../common/command_table.h"
+#include "../common/game_state.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct LoadgenOptions {
+    std::string host = GameConstants::DEFAULT_HOST;
+    int port = GameConstants::DEFAULT_PORT;
+    int players = 1000;
+    int roomSize = 4;
+    int questions = 5;
+    int threads = 1;
+    int timeoutSeconds = 60;
+    std::string prefix;
+    bool loginStorm = false;   // register, log in repeatedly, quit; no games
+    int logins = 5;
+};
+
+// Latency samples in microseconds, one vector per command
+struct CommandStats {
+    std::vector<uint32_t> samples[CommandTable::COMMAND_COUNT];
+    uint64_t errors[CommandTable::COMMAND_COUNT] = {};
+
+    void merge(CommandStats& other) {
+        for (size_t i = 0; i < CommandTable::COMMAND_COUNT; ++i) {
+            samples[i].insert(samples[i].end(), other.samples[i].begin(), other.samples[i].end());
+            errors[i] += other.errors[i];
+        }
+    }
+};
+
+enum class Phase {
+    CONNECTING,
+    REGISTERING,
+    LOGGING_IN,
+    WAITING_FOR_ROOM,   // joiner: logged in, room not created yet
+    JOINING,
+    WAITING_FOR_START,
+    ANSWERING,
+    FINISHING,
+    DONE,
+    FAILED
+};
+
+struct Room;
+
+struct Player {
+    int socket = -1;
+    std::string username;
+    Room* room = nullptr;
+    bool isHost = false;
+    Phase phase = Phase::CONNECTING;
+    int answered = 0;
+    int logins = 0;
+
+    CommandId outstanding = CommandId::UNKNOWN;
+    Clock::time_point sentAt;
+    std::string input;
+    std::string output;   // bytes the socket did not take yet
+    bool writeWatched = false;
+};
+
+struct Room {
+    int roomId = -1;
+    std::vector<Player*> members;   // members[0] is the host
+    int settledJoiners = 0;         // joiners whose JOIN_ROOM has been answered
+};
+
+class LoadgenWorker {
+public:
+    LoadgenWorker(const LoadgenOptions& opts, int id) : options(opts), epollFd(-1), random(id * 7919u + 17u) {}
+
+    ~LoadgenWorker() {
+        for (auto& player : players) {
+            if (player->socket != -1) close(player->socket);
+        }
+        if (epollFd != -1) close(epollFd);
+    }
+
+    void addRoom(int firstPlayer, int memberCount) {
+        rooms.push_back(std::make_unique<Room>());
+        Room* room = rooms.back().get();
+        for (int i = 0; i < memberCount; ++i) {
+            players.push_back(std::make_unique<Player>());
+            Player* player = players.back().get();
+            player->username = options.prefix + std::to_string(firstPlayer + i);
+            player->room = room;
+            player->isHost = (i == 0);
+            room->members.push_back(player);
+        }
+    }
+
+    void run(Clock::time_point deadline);
+
+    CommandStats stats;
+    int finished = 0;
+    int failed = 0;
+    size_t playerCount() const { return players.size(); }
+
+private:
+    const LoadgenOptions& options;
+    int epollFd;
+    std::mt19937 random;
+    std::vector<std::unique_ptr<Room>> rooms;
+    std::vector<std::unique_ptr<Player>> players;
+
+    bool connectPlayer(Player& player, const sockaddr_in& addr);
+    void send(Player& player, CommandId command, std::initializer_list<std::string_view> params);
+    void flush(Player& player);
+    void onReadable(Player& player);
+    void onLine(Player& player, std::string_view line);
+    void onReply(Player& player, CommandId command, std::string_view reply);
+    void startAnswering(Player& player);
+    void finish(Player& player);
+    void fail(Player& player);
+};
+
+bool LoadgenWorker::connectPlayer(Player& player, const sockaddr_in& addr) {
+    player.socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (player.socket == -1) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(player.socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(player.socket, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1 && errno != EINPROGRESS) {
+        return false;
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = &player;
+    player.writeWatched = true;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, player.socket, &ev) == 0;
+}
+
+void LoadgenWorker::send(Player& player, CommandId command, std::initializer_list<std::string_view> params) {
+    MessageAppender message(player.output, CommandTable::NAMES[static_cast<size_t>(command)]);
+    for (std::string_view param : params) {
+        message.add(param);
+    }
+    player.output += '\n';
+    player.outstanding = command;
+    player.sentAt = Clock::now();
+    flush(player);
+}
+
+void LoadgenWorker::flush(Player& player) {
+    while (!player.output.empty()) {
+        ssize_t sent = ::send(player.socket, player.output.data(), player.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fail(player);
+                return;
+            }
+            break;
+        }
+        player.output.erase(0, static_cast<size_t>(sent));
+    }
+    bool wantWrite = !player.output.empty();
+    if (wantWrite != player.writeWatched) {
+        epoll_event ev{};
+        ev.events = wantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        ev.data.ptr = &player;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, player.socket, &ev);
+        player.writeWatched = wantWrite;
+    }
+}
+
+void LoadgenWorker::onReadable(Player& player) {
+    char buffer[4096];
+    bool closed = false;
+    for (;;) {
+        ssize_t received = recv(player.socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            player.input.append(buffer, static_cast<size_t>(received));
+            continue;
+        }
+        if (received < 0 && errno == EINTR) continue;
+        closed = !(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+        break;
+    }
+    size_t start = 0;
+    size_t newline;
+    while ((newline = player.input.find('\n', start)) != std::string::npos) {
+        onLine(player, std::string_view(player.input).substr(start, newline - start));
+        if (player.phase == Phase::DONE || player.phase == Phase::FAILED) {
+            return;
+        }
+        start = newline + 1;
+    }
+    player.input.erase(0, start);
+    // Closed by the server before the script reached QUIT
+    if (closed) {
+        fail(player);
+    }
+}
+
+void LoadgenWorker::onLine(Player& player, std::string_view line) {
+    // The server pushes the first question to the whole room when a game
+    // starts, the final standings when its time runs out and, with question
+    // deadlines on, a TIMEOUT result for unanswered questions; anything that
+    // does not answer a pending request is a push
+    bool questionPush = line.rfind("GAME_RESPONSE|QUESTION|", 0) == 0
+                        && player.outstanding != CommandId::GET_CURRENT_QUESTION;
+    bool finishedPush = line.rfind("GAME_RESPONSE|GAME_FINISHED|", 0) == 0;
+    bool timeoutPush = line.rfind("GAME_RESPONSE|ANSWER_RESULT|TIMEOUT|", 0) == 0
+                       && player.outstanding != CommandId::SUBMIT_ANSWER;
+    if (questionPush || finishedPush || timeoutPush || player.outstanding == CommandId::UNKNOWN) {
+        // The host still waits for its START_GAME reply and starts from there
+        if (questionPush && player.phase == Phase::WAITING_FOR_START && player.outstanding == CommandId::UNKNOWN) {
+            startAnswering(player);
+        }
+        return;
+    }
+    CommandId command = player.outstanding;
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - player.sentAt).count();
+    stats.samples[static_cast<size_t>(command)].push_back(static_cast<uint32_t>(latency));
+    if (line.rfind("ERROR", 0) == 0 || line.rfind("GAME_RESPONSE|ERROR", 0) == 0) {
+        stats.errors[static_cast<size_t>(command)]++;
+    }
+    player.outstanding = CommandId::UNKNOWN;
+    onReply(player, command, line);
+}
+
+void LoadgenWorker::onReply(Player& player, CommandId command, std::string_view reply) {
+    Room& room = *player.room;
+    bool ok = reply.rfind("ERROR", 0) != 0;
+    switch (command) {
+        case CommandId::REGISTER:
+            // Already registered by an earlier run with the same prefix is fine
+            player.phase = Phase::LOGGING_IN;
+            send(player, CommandId::LOGIN, {player.username, "loadgen"});
+            break;
+        case CommandId::LOGIN:
+            if (!ok) {
+                fail(player);
+            } else if (options.loginStorm) {
+                if (++player.logins < options.logins) {
+                    send(player, CommandId::LOGIN, {player.username, "loadgen"});
+                } else {
+                    player.phase = Phase::FINISHING;
+                    send(player, CommandId::QUIT, {});
+                }
+            } else if (player.isHost) {
+                // Rooms larger than a standard room need to be arenas
+                send(player, CommandId::CREATE_ROOM,
+                     {player.username, "loadgen", options.roomSize > GameConstants::MAX_PLAYERS_PER_ROOM ? "ARENA" : "STANDARD"});
+            } else if (room.roomId > 0) {
+                player.phase = Phase::JOINING;
+                send(player, CommandId::JOIN_ROOM, {player.username, std::to_string(room.roomId)});
+            } else {
+                player.phase = Phase::WAITING_FOR_ROOM;
+            }
+            break;
+        case CommandId::CREATE_ROOM: {
+            ProtocolMessageView parsed = parseMessageView(reply);
+            int roomId = -1;
+            if (!ok || parsed.size() < 2 || !parseIntField(parsed[1], roomId)) {
+                for (Player* member : room.members) fail(*member);
+                break;
+            }
+            room.roomId = roomId;
+            player.phase = Phase::WAITING_FOR_START;
+            std::string roomIdText = std::to_string(roomId);
+            for (Player* member : room.members) {
+                if (member->phase == Phase::WAITING_FOR_ROOM) {
+                    member->phase = Phase::JOINING;
+                    send(*member, CommandId::JOIN_ROOM, {member->username, roomIdText});
+                }
+            }
+            if (room.members.size() == 1) {
+                send(player, CommandId::START_GAME, {player.username, roomIdText, std::to_string(options.questions)});
+            }
+            break;
+        }
+        case CommandId::JOIN_ROOM:
+            if (ok) {
+                player.phase = Phase::WAITING_FOR_START;
+            } else {
+                fail(player);
+            }
+            if (++room.settledJoiners == static_cast<int>(room.members.size()) - 1) {
+                Player& host = *room.members[0];
+                send(host, CommandId::START_GAME, {host.username, std::to_string(room.roomId), std::to_string(options.questions)});
+            }
+            break;
+        case CommandId::START_GAME:
+            if (!ok || reply.find("GAME_STARTED") == std::string_view::npos) {
+                for (Player* member : room.members) {
+                    if (member->phase == Phase::WAITING_FOR_START) finish(*member);
+                }
+            } else if (player.phase == Phase::WAITING_FOR_START) {
+                startAnswering(player);
+            }
+            break;
+        case CommandId::SUBMIT_ANSWER:
+            player.answered++;
+            if (!ok || reply.find("GAME_FINISHED") != std::string_view::npos || player.answered >= options.questions) {
+                finish(player);
+            } else {
+                send(player, CommandId::GET_CURRENT_QUESTION, {player.username, std::to_string(room.roomId)});
+            }
+            break;
+        case CommandId::GET_CURRENT_QUESTION:
+            if (!ok || reply.find("QUESTION|") == std::string_view::npos) {
+                finish(player);
+            } else {
+                send(player, CommandId::SUBMIT_ANSWER, {player.username, std::to_string(room.roomId), std::to_string(random() % 4 + 1)});
+            }
+            break;
+        case CommandId::GET_LEADERBOARD:
+            send(player, CommandId::QUIT, {});
+            break;
+        case CommandId::QUIT:
+            player.phase = Phase::DONE;
+            finished++;
+            close(player.socket);
+            player.socket = -1;
+            break;
+        default:
+            break;
+    }
+}
+
+void LoadgenWorker::startAnswering(Player& player) {
+    player.phase = Phase::ANSWERING;
+    send(player, CommandId::SUBMIT_ANSWER, {player.username, std::to_string(player.room->roomId), std::to_string(random() % 4 + 1)});
+}
+
+void LoadgenWorker::finish(Player& player) {
+    player.phase = Phase::FINISHING;
+    send(player, CommandId::GET_LEADERBOARD, {player.username, std::to_string(player.room->roomId)});
+}
+
+void LoadgenWorker::fail(Player& player) {
+    if (player.phase == Phase::DONE || player.phase == Phase::FAILED) {
+        return;
+    }
+    player.phase = Phase::FAILED;
+    failed++;
+    if (player.socket != -1) {
+        close(player.socket);
+        player.socket = -1;
+    }
+}
+
+void LoadgenWorker::run(Clock::time_point deadline) {
+    epollFd = epoll_create1(0);
+    if (epollFd == -1) {
+        std::cerr << "epoll_create1 failed: " << errno << std::endl;
+        return;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr);
+    for (auto& player : players) {
+        if (!connectPlayer(*player, addr)) {
+            fail(*player);
+        }
+    }
+
+    std::vector<epoll_event> events(1024);
+    size_t total = players.size();
+    while (static_cast<size_t>(finished + failed) < total && Clock::now() < deadline) {
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 100);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << errno << std::endl;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            Player& player = *static_cast<Player*>(events[i].data.ptr);
+            if (player.socket == -1) {
+                continue;
+            }
+            if (player.phase == Phase::CONNECTING) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(player.socket, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0 || (events[i].events & (EPOLLERR | EPOLLHUP))) {
+                    fail(player);
+                    continue;
+                }
+                player.phase = Phase::REGISTERING;
+                send(player, CommandId::REGISTER, {player.username, "loadgen"});
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flush(player);
+            }
+            if (player.socket != -1 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                onReadable(player);
+            }
+        }
+    }
+}
+
+static uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void printReport(CommandStats& stats, double seconds, int players, int finished, int failed) {
+    uint64_t totalRequests = 0;
+    for (auto& samples : stats.samples) {
+        totalRequests += samples.size();
+    }
+    std::cout << "Players: " << players << " (finished " << finished << ", failed " << failed
+              << ", unfinished " << (players - finished - failed) << ")" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "Elapsed: " << seconds << " s, requests: " << totalRequests
+              << ", throughput: " << std::setprecision(0) << (seconds > 0 ? totalRequests / seconds : 0) << " req/s" << std::endl;
+    std::cout << std::left << std::setw(22) << "command" << std::right
+              << std::setw(9) << "count" << std::setw(8) << "errors"
+              << std::setw(11) << "p50(us)" << std::setw(11) << "p99(us)"
+              << std::setw(11) << "p999(us)" << std::setw(11) << "max(us)" << std::endl;
+    for (size_t i = 0; i < CommandTable::COMMAND_COUNT; ++i) {
+        std::vector<uint32_t>& samples = stats.samples[i];
+        if (samples.empty()) {
+            continue;
+        }
+        std::sort(samples.begin(), samples.end());
+        std::cout << std::left << std::setw(22) << CommandTable::NAMES[i] << std::right
+                  << std::setw(9) << samples.size() << std::setw(8) << stats.errors[i]
+                  << std::setw(11) << percentile(samples, 0.50) << std::setw(11) << percentile(samples, 0.99)
+                  << std::setw(11) << percentile(samples, 0.999) << std::setw(11) << samples.back() << std::endl;
+    }
+}
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--host=ADDR] [--port=N] [--players=N] [--room-size=N]"
+              << " [--questions=N] [--threads=N] [--timeout=SECONDS] [--prefix=NAME]"
+              << " [--scenario=game|login-storm] [--logins=N]" << std::endl;
+}
+
+static bool parseIntOption(const std::string& arg, const char* name, int& value) {
+    std::string flag = std::string("--") + name + "=";
+    if (arg.rfind(flag, 0) != 0) {
+        return false;
+    }
+    return parseIntField(std::string_view(arg).substr(flag.size()), value) && value > 0;
+}
+
+int main(int argc, char* argv[]) {
+    LoadgenOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--host=", 0) == 0) {
+            options.host = arg.substr(7);
+        } else if (arg.rfind("--prefix=", 0) == 0) {
+            options.prefix = arg.substr(9);
+        } else if (arg == "--scenario=game" || arg == "--scenario=login-storm") {
+            options.loginStorm = (arg == "--scenario=login-storm");
+        } else if (!parseIntOption(arg, "port", options.port)
+                   && !parseIntOption(arg, "logins", options.logins)
+                   && !parseIntOption(arg, "players", options.players)
+                   && !parseIntOption(arg, "room-size", options.roomSize)
+                   && !parseIntOption(arg, "questions", options.questions)
+                   && !parseIntOption(arg, "threads", options.threads)
+                   && !parseIntOption(arg, "timeout", options.timeoutSeconds)) {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.prefix.empty()) {
+        // Usernames are limited to 20 characters; keep the run tag short
+        options.prefix = "lg" + std::to_string(std::random_device()() % 1000000) + "_";
+    }
+
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    // Whole rooms go to one worker so a room's players never need to synchronize
+    std::vector<std::unique_ptr<LoadgenWorker>> workers;
+    for (int i = 0; i < options.threads; ++i) {
+        workers.push_back(std::make_unique<LoadgenWorker>(options, i));
+    }
+    int roomIndex = 0;
+    for (int first = 0; first < options.players; first += options.roomSize, ++roomIndex) {
+        int members = std::min(options.roomSize, options.players - first);
+        workers[roomIndex % options.threads]->addRoom(first, members);
+    }
+
+    if (options.loginStorm) {
+        std::cout << "Login storm: " << options.players << " players logging in " << options.logins << " time(s) each";
+    } else {
+        std::cout << "Running " << options.players << " players in rooms of " << options.roomSize;
+    }
+    std::cout << " on " << options.threads << " thread(s) against " << options.host << ":" << options.port << std::endl;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::seconds(options.timeoutSeconds);
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        LoadgenWorker* w = worker.get();
+        threads.emplace_back([w, deadline]() { w->run(deadline); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    CommandStats stats;
+    int finished = 0;
+    int failed = 0;
+    for (auto& worker : workers) {
+        stats.merge(worker->stats);
+        finished += worker->finished;
+        failed += worker->failed;
+    }
+    printReport(stats, seconds, options.players, finished, failed);
+    return (finished == options.players) ? 0 : 1;
+}
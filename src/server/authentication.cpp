@@ -4,10 +4,12 @@
 #include <iostream>
 #include <algorithm>
 #include "debug_log.h"
+#include "password_hash.h"
 #include <ctime>
 
-AuthenticationManager::AuthenticationManager(const std::string& dataFile) 
-    : userDataFile(dataFile) {
+AuthenticationManager::AuthenticationManager(const std::string& dataFile, int passwordHashCost) 
+    : userDataFile(dataFile), userLog(dataFile), hashCost(passwordHashCost),
+      dummyHash(hashPassword("", passwordHashCost)) {
     loadUsersFromFile();
     if (users.empty()) {
         createAdminUser("admin", "admin123");
@@ -15,23 +17,21 @@ AuthenticationManager::AuthenticationManager(const std::string& dataFile)
 }
 
 AuthenticationManager::~AuthenticationManager() {
-    saveUsersToFile();
+    closeUserLog();
 }
 
 bool containsWhitespaceOrNewline(const std::string& s) {
     return s.find_first_of(" \t\n\r") != std::string::npos;
 }
 
-bool AuthenticationManager::registerUser(const std::string& username, const std::string& password) {
-    debugLogMsg("Attempting to register username: '" + username + "'");
-    std::string currentUsers = "Current users: ";
-    for (const auto& pair : users) currentUsers += "'" + pair.first + "' ";
-    debugLogMsg(currentUsers);
+bool AuthenticationManager::registerUser(const std::string& username, const std::string& password,
+                                         std::function<void(bool)> onDurable) {
+    DEBUG_LOG(LogLevel::DEBUG, "Attempting to register username: '" + username + "'");
     if (username.empty() || password.empty()) {
         return false;
     }
     if (containsWhitespaceOrNewline(username) || containsWhitespaceOrNewline(password)) {
-        debugLogMsg("ERROR: Username and password must not contain spaces or newlines.");
+        DEBUG_LOG(LogLevel::INFO, "Username and password must not contain spaces or newlines.");
         return false;
     }
     
@@ -43,118 +43,124 @@ bool AuthenticationManager::registerUser(const std::string& username, const std:
         return false;
     }
     
-    debugLogMsg("Checking if username exists: '" + username + "'");
     if (userExists(username)) {
-        debugLogMsg("Username already exists: '" + username + "'");
+        DEBUG_LOG(LogLevel::INFO, "Username already exists: '" + username + "'");
         return false;
     }
     
-    User newUser(username, password);
-    users[username] = newUser;
-    
-    saveUsersToFile();
+    // Hashing is slow by design; other logins must not wait behind it
+    std::string passwordHash = hashPassword(password, hashCost);
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    User newUser(username, passwordHash);
+    if (!users.insert(newUser)) {
+        return false;   // registered by someone else while we were hashing
+    }
+    userLog.append(newUser, std::move(onDurable));
     
     std::cout << "User registered: " << username << std::endl;
     return true;
 }
 
 bool AuthenticationManager::authenticateUser(const std::string& username, const std::string& password) {
-    auto it = users.find(username);
-    if (it == users.end()) {
-        return false;
+    std::string stored;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        const User* user = users.find(username);
+        if (user) {
+            stored = user->getPassword();
+        }
     }
     
-    return it->second.getPassword() == password;
+    // An unknown user, or a wrong plaintext password, is checked against a
+    // dummy hash too, so a failed LOGIN takes as long either way
+    int storedLogN = 0;
+    if (stored.empty() || !verifyPassword(password, stored, storedLogN)) {
+        if (storedLogN == 0) {
+            int dummyLogN = 0;
+            verifyPassword(password, dummyHash, dummyLogN);
+        }
+        return false;
+    }
+    // Plaintext records from before hashing, and hashes made at another
+    // cost, are replaced now that the password is known
+    if (storedLogN != hashCost) {
+        std::string upgraded = hashPassword(password, hashCost);
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        User* user = users.find(username);
+        if (user && user->getPassword() == stored) {
+            user->setPassword(upgraded);
+            userLog.append(*user);
+        }
+    }
+    return true;
 }
 
-bool AuthenticationManager::userExists(const std::string& username) const {
-    debugLogMsg("userExists called for: '" + username + "'");
-    for (const auto& pair : users) {
-        debugLogMsg("Comparing to: '" + pair.first + "'");
+PlayerId AuthenticationManager::login(const std::string& username, const std::string& password) {
+    if (!authenticateUser(username, password)) {
+        return INVALID_PLAYER_ID;
     }
-    return users.find(username) != users.end();
+    return playerDirectory.intern(username);
+}
+
+bool AuthenticationManager::userExists(const std::string& username) const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool exists = users.find(username) != nullptr;
+    DEBUG_LOG(LogLevel::DEBUG, "userExists('" + username + "'): " + (exists ? "yes" : "no"));
+    return exists;
 }
 
 User* AuthenticationManager::getUser(const std::string& username) {
-    auto it = users.find(username);
-    if (it != users.end()) {
-        return &(it->second);
-    }
-    return nullptr;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return users.find(username);
 }
 
 bool AuthenticationManager::updateUser(const User& user) {
-    auto it = users.find(user.getUsername());
-    if (it != users.end()) {
-        it->second = user;
-        saveUsersToFile();
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    User* existing = users.find(user.getUsername());
+    if (existing) {
+        *existing = user;
+        userLog.append(user);
         return true;
     }
     return false;
 }
 
 std::vector<std::string> AuthenticationManager::getAllUsernames() const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     std::vector<std::string> usernames;
-    for (const auto& pair : users) {
-        usernames.push_back(pair.first);
+    usernames.reserve(users.size());
+    for (const User& user : users.all()) {
+        usernames.push_back(user.getUsername());
     }
     return usernames;
 }
 
 bool AuthenticationManager::loadUsersFromFile() {
-    std::ifstream file(userDataFile);
-    if (!file.is_open()) {
-        std::cout << "No existing user file found. Starting fresh." << std::endl;
-        return false;
-    }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string username, password;
-        int currentRoomId, score;
-        bool isAdmin;
-        
-        if (iss >> username >> password >> currentRoomId >> score >> isAdmin) {
-            User user(username, password);
-            user.setCurrentRoomId(currentRoomId);
-            user.setScore(score);
-            user.setIsAdmin(isAdmin);
-            users[username] = user;
-        }
-    }
-    
-    file.close();
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    bool ok = userLog.recover([this](const User& user) { users.put(user); });
     std::cout << "Loaded " << users.size() << " users from file." << std::endl;
-    return true;
+    return ok;
 }
 
-bool AuthenticationManager::saveUsersToFile() const {
-    std::ofstream file(userDataFile);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open user file for writing." << std::endl;
-        return false;
-    }
-    
-    for (const auto& pair : users) {
-        const User& user = pair.second;
-        file << user.getUsername() << " " 
-             << user.getPassword() << " "
-             << user.getCurrentRoomId() << " "
-             << user.getScore() << " "
-             << (user.getIsAdmin() ? 1 : 0) << std::endl;
-    }
-    
-    file.close();
-    return true;
+bool AuthenticationManager::saveUsersToFile() {
+    return userLog.flush();
+}
+
+bool AuthenticationManager::canSaveUsers() const {
+    return userLog.isOpen();
+}
+
+void AuthenticationManager::closeUserLog() {
+    userLog.close();
 }
 
 bool AuthenticationManager::createAdminUser(const std::string& username, const std::string& password) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
     if (registerUser(username, password)) {
         User* user = getUser(username);
         if (user) {
             user->setIsAdmin(true);
-            saveUsersToFile();
+            userLog.append(*user);
             std::cout << "Admin user created: " << username << std::endl;
             return true;
         }
@@ -163,9 +169,7 @@ bool AuthenticationManager::createAdminUser(const std::string& username, const s
 }
 
 bool AuthenticationManager::isAdmin(const std::string& username) const {
-    auto it = users.find(username);
-    if (it != users.end()) {
-        return it->second.getIsAdmin();
-    }
-    return false;
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    const User* user = users.find(username);
+    return user && user->getIsAdmin();
 } 
\ No newline at end of file
@@ -2,22 +2,42 @@
 #define AUTHENTICATION_H
 
 #include <string>
-#include <map>
 #include <vector>
+#include <mutex>
+#include <functional>
 #include "../common/user.h"
 #include "../common/game_state.h"
+#include "player_directory.h"
+#include "user_log.h"
+#include "user_table.h"
+#include "password_hash.h"
 
 class AuthenticationManager {
 private:
-    std::map<std::string, User> users;  
+    UserTable users;  
     std::string userDataFile;  
+    mutable std::recursive_mutex mutex;   // shared by every server shard
+    PlayerDirectory playerDirectory;
+    UserLog userLog;   // users.txt snapshot + append-only log
+    int hashCost;      // log2 of the scrypt N for new password hashes
+    std::string dummyHash;   // checked on a failed login that hashed nothing, to hide whether the user exists
 
 public:
-    AuthenticationManager(const std::string& dataFile = "data/users.txt");
+    AuthenticationManager(const std::string& dataFile = "data/users.txt",
+                          int passwordHashCost = PasswordHashing::DEFAULT_LOG_N);
     ~AuthenticationManager();
 
-    bool registerUser(const std::string& username, const std::string& password);
+    // registerUser and authenticateUser hash the password, which takes tens
+    // of milliseconds: call them from a worker thread, not an event loop.
+    // onDurable runs on the log writer thread once the new account is on
+    // disk, or with false if it could not be saved
+    bool registerUser(const std::string& username, const std::string& password,
+                      std::function<void(bool)> onDurable = nullptr);
     bool authenticateUser(const std::string& username, const std::string& password);
+    // Authenticates and returns the user's PlayerId, or INVALID_PLAYER_ID
+    PlayerId login(const std::string& username, const std::string& password);
+    const PlayerDirectory& getPlayerDirectory() const { return playerDirectory; }
+    PlayerDirectory& getPlayerDirectory() { return playerDirectory; }
     bool userExists(const std::string& username) const;
     
     User* getUser(const std::string& username);
@@ -26,7 +46,13 @@ public:
     
     // Data persistence
     bool loadUsersFromFile();
-    bool saveUsersToFile() const;
+    // Waits until every change so far is on disk
+    bool saveUsersToFile();
+    // False if the user log could not be opened; new accounts would be lost
+    bool canSaveUsers() const;
+    // Flushes the log and folds it into the snapshot; call once no shard
+    // can register users any more
+    void closeUserLog();
     
     bool createAdminUser(const std::string& username, const std::string& password);
     bool isAdmin(const std::string& username) const;
@@ -0,0 +1,35 @@
+#ifndef CLIENT_SESSION_H
+#define CLIENT_SESSION_H
+
+#include <string>
+#include <cstdint>
+#include "../common/game_state.h"
+#include "../common/player_id.h"
+#include "input_buffer.h"
+#include "output_queue.h"
+
+struct ClientSession {
+    int socket;
+    uint64_t connectionId;   // unique for the server's lifetime; guards replies against socket reuse
+    std::string username;
+    PlayerId playerId;   // interned at LOGIN
+    std::string resumeToken;   // issued at LOGIN for RESUME; empty once revoked
+    bool authenticated;
+    int currentRoomId;
+    InputBuffer input;
+    OutputQueue output;
+    bool writeWatched;   // reactor is watching the socket for writability
+    bool closing;        // scheduled for removal; nothing more is read or queued
+
+    // Cross-shard state: set while the session waits for another shard
+    bool awaitingReply;
+    int migrateTo;
+    std::string pendingMessage;   // command to replay on the shard the session moves to
+
+    ClientSession(int s, uint64_t id)
+        : socket(s), connectionId(id), playerId(INVALID_PLAYER_ID), authenticated(false), currentRoomId(-1),
+          input(GameConstants::MAX_MESSAGE_LENGTH), writeWatched(false), closing(false),
+          awaitingReply(false), migrateTo(-1) {}
+};
+
+#endif
@@ -1,8 +1,126 @@
 #include "debug_log.h"
 #include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
 
-// Debug logging
-std::ofstream debugLog;
+namespace {
+    const size_t RING_CAPACITY = 8192;   // power of two
+    const int HEX_DUMPS_PER_SECOND = 50;
+    const auto WRITER_IDLE_SLEEP = std::chrono::milliseconds(5);
+
+    // Bounded multi-producer single-consumer ring. Each slot carries a
+    // sequence number that tells producers and the writer whose turn it is.
+    struct LogSlot {
+        std::atomic<size_t> sequence;
+        LogLevel level;
+        std::string text;
+    };
+
+    struct LogRing {
+        std::unique_ptr<LogSlot[]> slots;
+        std::atomic<size_t> enqueuePos;
+        size_t dequeuePos;   // only touched by the writer thread
+
+        LogRing() : slots(new LogSlot[RING_CAPACITY]), enqueuePos(0), dequeuePos(0) {
+            for (size_t i = 0; i < RING_CAPACITY; ++i) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(LogLevel level, std::string& text) {
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            LogSlot* slot;
+            for (;;) {
+                slot = &slots[pos & (RING_CAPACITY - 1)];
+                size_t seq = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;   // full
+                } else {
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            slot->level = level;
+            slot->text = std::move(text);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(LogLevel& level, std::string& text) {
+            LogSlot& slot = slots[dequeuePos & (RING_CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+                return false;
+            }
+            level = slot.level;
+            text.swap(slot.text);
+            slot.text.clear();
+            slot.sequence.store(dequeuePos + RING_CAPACITY, std::memory_order_release);
+            ++dequeuePos;
+            return true;
+        }
+    };
+
+    LogRing logRing;
+    std::ofstream debugLog;
+    std::thread writerThread;
+    std::atomic<bool> writerRunning(false);
+    std::atomic<uint64_t> droppedMessages(0);
+
+    std::atomic<int64_t> hexDumpWindow(0);
+    std::atomic<int> hexDumpsInWindow(0);
+
+    const char* levelTag(LogLevel level) {
+        switch (level) {
+            case LogLevel::ERROR: return "[ERROR] ";
+            case LogLevel::INFO:  return "[INFO] ";
+            case LogLevel::DEBUG: return "[DEBUG] ";
+            case LogLevel::TRACE: return "[TRACE] ";
+        }
+        return "";
+    }
+
+    // Moves everything queued into one buffer and writes it with a single flush
+    void drainRing(std::string& batch) {
+        LogLevel level;
+        std::string text;
+        batch.clear();
+        while (logRing.pop(level, text)) {
+            batch += levelTag(level);
+            batch += text;
+            batch += '\n';
+        }
+        uint64_t dropped = droppedMessages.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            batch += "[ERROR] Log buffer full, dropped " + std::to_string(dropped) + " messages\n";
+        }
+        if (!batch.empty()) {
+            debugLog.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            debugLog.flush();
+        }
+    }
+
+    void writerLoop() {
+        std::string batch;
+        while (writerRunning.load(std::memory_order_acquire)) {
+            drainRing(batch);
+            if (batch.empty()) {
+                std::this_thread::sleep_for(WRITER_IDLE_SLEEP);
+            }
+        }
+        drainRing(batch);
+    }
+}
+
+std::atomic<int> debugLogLevel(static_cast<int>(LogLevel::INFO));
 
 void initDebugLog() {
     debugLog.open("server_debug.log", std::ios::app);
@@ -11,18 +129,75 @@ void initDebugLog() {
         char* dt = ctime(&now);
         debugLog << "\n=== Server Debug Log Started: " << dt;
         debugLog.flush();
+        writerRunning.store(true, std::memory_order_release);
+        writerThread = std::thread(writerLoop);
+    }
+}
+
+void setDebugLogLevel(LogLevel level) {
+    debugLogLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool parseLogLevel(const std::string& name, LogLevel& level) {
+    if (name == "error") {
+        level = LogLevel::ERROR;
+    } else if (name == "info") {
+        level = LogLevel::INFO;
+    } else if (name == "debug") {
+        level = LogLevel::DEBUG;
+    } else if (name == "trace") {
+        level = LogLevel::TRACE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void debugLogWrite(LogLevel level, std::string msg) {
+    if (!writerRunning.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // Never block the caller: a full ring drops the message and counts it
+    if (!logRing.push(level, msg)) {
+        droppedMessages.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
 void debugLogMsg(const std::string& msg) {
-    if (debugLog.is_open()) {
-        debugLog << "[DEBUG] " << msg << std::endl;
-        debugLog.flush();
+    DEBUG_LOG(LogLevel::DEBUG, msg);
+}
+
+void debugLogHexDump(std::string_view label, std::string_view bytes) {
+    if (!debugLogEnabled(LogLevel::TRACE)) {
+        return;
+    }
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t window = hexDumpWindow.load(std::memory_order_relaxed);
+    if (window != second && hexDumpWindow.compare_exchange_strong(window, second, std::memory_order_relaxed)) {
+        hexDumpsInWindow.store(0, std::memory_order_relaxed);
+    }
+    if (hexDumpsInWindow.fetch_add(1, std::memory_order_relaxed) >= HEX_DUMPS_PER_SECOND) {
+        return;
     }
+
+    static const char digits[] = "0123456789ABCDEF";
+    std::string dump;
+    dump.reserve(label.size() + bytes.size() * 3);
+    dump.append(label.data(), label.size());
+    for (unsigned char c : bytes) {
+        dump += digits[c >> 4];
+        dump += digits[c & 0x0F];
+        dump += ' ';
+    }
+    debugLogWrite(LogLevel::TRACE, std::move(dump));
 }
 
 void closeDebugLog() {
+    if (writerRunning.exchange(false, std::memory_order_acq_rel)) {
+        writerThread.join();
+    }
     if (debugLog.is_open()) {
         debugLog.close();
     }
-} 
\ No newline at end of file
+}
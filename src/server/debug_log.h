@@ -2,14 +2,40 @@
 #define DEBUG_LOG_H
 
 #include <string>
-#include <fstream>
-#include <ctime>
+#include <string_view>
+#include <atomic>
 
-// Debug logging
-extern std::ofstream debugLog;
+// Debug logging. Messages are handed to a lock-free ring buffer and written
+// to server_debug.log in batches by a background thread, so logging never
+// touches the disk on an event-loop thread.
+enum class LogLevel : int {
+    ERROR = 0,
+    INFO,
+    DEBUG,
+    TRACE   // includes hex dumps of outbound frames
+};
+
+extern std::atomic<int> debugLogLevel;
+
+inline bool debugLogEnabled(LogLevel level) {
+    return static_cast<int>(level) <= debugLogLevel.load(std::memory_order_relaxed);
+}
+
+// Checks the level before the message expression is evaluated
+#define DEBUG_LOG(level, message)                 \
+    do {                                          \
+        if (debugLogEnabled(level)) {             \
+            debugLogWrite(level, message);        \
+        }                                         \
+    } while (0)
 
 void initDebugLog();
+void setDebugLogLevel(LogLevel level);
+bool parseLogLevel(const std::string& name, LogLevel& level);
+void debugLogWrite(LogLevel level, std::string msg);
 void debugLogMsg(const std::string& msg);
+// Logs the bytes as hex at TRACE level, at most a few dozen dumps per second
+void debugLogHexDump(std::string_view label, std::string_view bytes);
 void closeDebugLog();
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,21 @@
+#ifndef DURABLE_FILE_H
+#define DURABLE_FILE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Helpers for files that have to survive a crash, shared by the user log
+// and the game snapshots
+namespace DurableFile {
+    uint32_t crc32(const char* data, size_t length);
+    // Writes all of data, retrying short writes; false on error
+    bool writeAll(int fd, const char* data, size_t length);
+    // Makes a rename or unlink in the file's directory durable
+    void syncDirectoryOf(const std::string& path);
+    // Atomically replaces path with bytes: writes path.tmp, fsyncs it and
+    // renames it over path. False, leaving path untouched, on any error
+    bool replace(const std::string& path, const std::string& bytes);
+}
+
+#endif
@@ -1,43 +1,48 @@
 #include "game_engine.h"
+#include "../common/game_state.h"
+#include "debug_log.h"
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
-#include <iostream> // Added for debug logs
+#include <iostream>
 
-GameEngine::GameEngine(RoomManager& rm, QuestionManager& qm) 
-    : roomManager(rm), questionManager(qm) {
+PlayerSlot* RoomGameState::findPlayer(PlayerId player) {
+    auto it = playerIndex.find(player);
+    return it != playerIndex.end() ? &players[it->second] : nullptr;
+}
+
+GameEngine::GameEngine(RoomManager& rm, QuestionManager& qm, const PlayerDirectory& pd)
+    : roomManager(rm), questionManager(qm), playerDirectory(pd), questionDeadlines(false) {
 }
 
 GameEngine::~GameEngine() {
 }
 
-bool GameEngine::isGameActive(int roomId) {
-    auto it = gameSessions.find(roomId);
-    return it != gameSessions.end() && it->second.currentState == GameSession::PLAYING;
+RoomGameState* GameEngine::findRoomState(int roomId) {
+    auto it = roomStateIndex.find(roomId);
+    return it != roomStateIndex.end() ? &roomStates[it->second] : nullptr;
+}
+
+bool GameEngine::isGameActive(const RoomGameState* state) const {
+    return state && state->session.currentState == GameSession::PLAYING;
 }
 
-void GameEngine::startNewRound(int roomId) {
-    auto& gameSession = gameSessions[roomId];
+void GameEngine::startNewRound(RoomGameState& state) {
+    auto& gameSession = state.session;
     gameSession.currentState = GameSession::PLAYING;
     gameSession.currentQuestionIndex = 0;
     gameSession.roundStartTime = std::chrono::steady_clock::now();
     gameSession.questionStartTime = std::chrono::steady_clock::now();
 }
 
-void GameEngine::endRound(int roomId) {
-    auto& gameSession = gameSessions[roomId];
-    gameSession.currentState = GameSession::FINISHED;
+void GameEngine::endRound(RoomGameState& state) {
+    state.session.currentState = GameSession::FINISHED;
 }
 
-std::string GameEngine::getGameStatus(int roomId) {
-    auto it = gameSessions.find(roomId);
-    if (it == gameSessions.end()) {
-        return "NO_GAME";
-    }
-    
-    const auto& gameSession = it->second;
+std::string GameEngine::getGameStatus(const RoomGameState& state) const {
+    const auto& gameSession = state.session;
     std::ostringstream oss;
-    
+
     switch (gameSession.currentState) {
         case GameSession::WAITING:
             oss << "WAITING";
@@ -49,281 +54,486 @@ std::string GameEngine::getGameStatus(int roomId) {
             oss << "FINISHED";
             break;
     }
-    
+
     return oss.str();
 }
 
-std::string GameEngine::getLeaderboard(int roomId) {
-    auto it = playerScores.find(roomId);
-    if (it == playerScores.end()) {
+// Ranked by score (descending), then by correct answers, then by username.
+// Arenas list only the top entries, followed by the reader's own entry when
+// it is not among them.
+std::string GameEngine::getLeaderboard(const RoomGameState* state, PlayerId reader) const {
+    if (!state) {
         return "NO_SCORES";
     }
-    
-    std::vector<std::pair<std::string, PlayerScore>> sortedScores;
-    for (const auto& pair : it->second) {
-        sortedScores.push_back(pair);
-    }
-    
-    // Sort by score (descending), then by correct answers, then by username
-    std::sort(sortedScores.begin(), sortedScores.end(), 
-        [](const auto& a, const auto& b) {
-            if (a.second.score != b.second.score) {
-                return a.second.score > b.second.score;
-            }
-            if (a.second.correctAnswers != b.second.correctAnswers) {
-                return a.second.correctAnswers > b.second.correctAnswers;
-            }
-            return a.first < b.first;
-        });
-    
-    std::ostringstream oss;
-    oss << "LEADERBOARD";
-    for (size_t i = 0; i < sortedScores.size(); ++i) {
-        const auto& player = sortedScores[i];
-        oss << "|" << (i + 1) << "." << player.first << ":" 
-            << player.second.score << "(" << player.second.correctAnswers 
-            << "/" << player.second.totalAnswers << ")";
-    }
-    
-    return oss.str();
+    if (!state->arena) {
+        return "LEADERBOARD" + state->leaderboard.serialized();
+    }
+    const size_t topSize = GameConstants::ARENA_LEADERBOARD_SIZE;
+    std::string result = "LEADERBOARD" + state->leaderboard.serializedTop(topSize);
+    if (state->leaderboard.rankOf(reader) > topSize) {
+        result += "|...";
+        state->leaderboard.appendPlayer(result, reader);
+    }
+    return result;
 }
 
-void GameEngine::awardPoints(int roomId, const std::string& username, bool correct, int timeBonus) {
-    auto& scores = playerScores[roomId];
-    auto& playerScore = scores[username];
-    
+void GameEngine::awardPoints(RoomGameState& state, PlayerSlot& player, bool correct, int timeBonus) {
+    auto& playerScore = player.score;
+
     playerScore.totalAnswers++;
     if (correct) {
         playerScore.correctAnswers++;
-        playerScore.score += 10 + timeBonus; 
+        playerScore.score += 10 + timeBonus;
     }
     playerScore.lastAnswerTime = std::chrono::steady_clock::now();
+    state.leaderboard.update(playerScore.playerId, playerScore.score, playerScore.correctAnswers,
+                             playerScore.totalAnswers);
 }
 
-std::string GameEngine::startGame(int roomId, const std::string& username, int questionCount) {
+// The answer clock starts the first time a player is shown a question
+void GameEngine::markDelivered(PlayerSlot& player, std::chrono::steady_clock::time_point now) {
+    if (player.deliveredIndex != player.questionIndex) {
+        player.deliveredIndex = player.questionIndex;
+        player.deliveredAt = now;
+    }
+}
+
+bool GameEngine::isQuestionOverdue(const RoomGameState& state, const PlayerSlot& player,
+                                   std::chrono::steady_clock::time_point now) const {
+    int limit = state.session.questionTimeLimit;
+    return limit > 0 && player.deliveredIndex == player.questionIndex
+           && now - player.deliveredAt >= std::chrono::seconds(limit);
+}
+
+std::string GameEngine::formatAnswerResult(const Question& question, const char* verdict,
+                                           const PlayerSlot& player, bool finished) const {
+    std::ostringstream oss;
+    oss << "ANSWER_RESULT|" << verdict
+        << "|" << (question.getCorrectAnswerIndex() + 1)
+        << "|" << question.getCorrectAnswer() << "|" << player.score.score;
+    if (finished) {
+        oss << "|GAME_FINISHED";
+    }
+    return oss.str();
+}
+
+// Record the current question as missed and move the player to the next one
+std::string GameEngine::timeOutQuestion(RoomGameState& state, PlayerSlot& player) {
+    const Question& question = *state.questions[player.questionIndex];
+    awardPoints(state, player, false);
+    player.questionIndex++;
+    bool finished = (player.questionIndex >= static_cast<int>(state.questions.size()));
+    return formatAnswerResult(question, "TIMEOUT", player, finished);
+}
+
+std::string GameEngine::startGame(int roomId, PlayerId player, int questionCount) {
     auto room = roomManager.getRoom(roomId);
-    if (!room || room->getHostUsername() != username) {
+    if (!room || room->getHostId() != player) {
         return "ERROR|Only room owner can start the game";
     }
-    
-    if (isGameActive(roomId)) {
+
+    RoomGameState* state = findRoomState(roomId);
+    if (isGameActive(state)) {
         return "ERROR|Game is already in progress";
     }
-    
+
     auto players = roomManager.getRoomPlayers(roomId);
     if (players.size() < 1) {
         return "ERROR|Need at least 1 player to start";
     }
-    
+
     auto questions = questionManager.getRandomQuestions(questionCount);
     if (questions.empty()) {
         return "ERROR|No questions available";
     }
-    
-    roomQuestions[roomId] = questions;
-    roomPlayers[roomId] = players;
-    
-    auto& gameSession = gameSessions[roomId];
+
+    if (!state) {
+        roomStateIndex[roomId] = roomStates.size();
+        roomStates.emplace_back();
+        state = &roomStates.back();
+        state->roomId = roomId;
+    }
+    state->questions = std::move(questions);
+    state->questionPositions.clear();
+    for (size_t i = 0; i < state->questions.size(); ++i) {
+        state->questionPositions.push_back(std::make_shared<const std::string>(
+            "QUESTION|" + std::to_string(i + 1) + "/" + std::to_string(state->questions.size())));
+    }
+
+    auto& gameSession = state->session;
     gameSession.currentState = GameSession::WAITING;
-    gameSession.totalQuestions = questions.size();
+    gameSession.totalQuestions = state->questions.size();
     gameSession.gameStartTime = std::chrono::steady_clock::now();
-    gameSession.gameDurationSeconds = 90; 
-    
-    auto& scores = playerScores[roomId];
-    scores.clear();
-    for (const auto& player : players) {
-        scores[player] = PlayerScore();
-        scores[player].username = player;
-        gameSession.playerQuestionIndex[player] = 0;
-    }
-    
-    startNewRound(roomId);
-    
+    gameSession.gameDurationSeconds = 90;
+    gameSession.questionTimeLimit = questionDeadlines ? GameConstants::QUESTION_TIME_LIMIT_SECONDS : 0;
+
+    // The first question is broadcast to everyone as the game starts
+    state->arena = room->isArena();
+    state->players.clear();
+    state->players.resize(players.size());
+    state->playerIndex.clear();
+    state->playerIndex.reserve(players.size());
+    state->leaderboard.clear();
+    for (size_t i = 0; i < players.size(); ++i) {
+        state->players[i].score.playerId = players[i];
+        state->playerIndex[players[i]] = i;
+        markDelivered(state->players[i], gameSession.gameStartTime);
+        state->leaderboard.add(players[i], &playerDirectory.nameOf(players[i]));
+    }
+
+    startNewRound(*state);
+
     std::ostringstream oss;
     oss << "GAME_STARTED|" << questionCount << " questions|" << players.size() << " players";
     return oss.str();
 }
 
-std::string GameEngine::endGame(int roomId, const std::string& username) {
+std::string GameEngine::endGame(int roomId, PlayerId player) {
     auto room = roomManager.getRoom(roomId);
-    if (!room || room->getHostUsername() != username) {
+    if (!room || room->getHostId() != player) {
         return "ERROR|Only room owner can end the game";
     }
-    
-    if (!isGameActive(roomId)) {
+
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state)) {
         return "ERROR|No active game to end";
     }
-    
-    endRound(roomId);
-    
-    std::string leaderboard = getLeaderboard(roomId);
-    
+
+    endRound(*state);
+
+    std::string leaderboard = getLeaderboard(state);
+
     cleanupRoom(roomId);
-    
+
     return "GAME_ENDED|" + leaderboard;
 }
 
-std::string GameEngine::getCurrentQuestion(int roomId, const std::string& username) {
-    if (!isGameActive(roomId)) {
+std::string GameEngine::getCurrentQuestion(int roomId, PlayerId playerId, QuestionFrame& frame) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state)) {
         return "ERROR|No active game";
     }
-    if (isGameTimerExpired(roomId)) {
-        endRound(roomId);
+    if (isGameTimerExpired(*state)) {
+        endRound(*state);
         return "ERROR|Game timer expired|GAME_FINISHED";
     }
-    if (!isPlayerInGame(roomId, username)) {
+    PlayerSlot* player = state->findPlayer(playerId);
+    if (!player) {
         return "ERROR|Player not in game";
     }
-    auto& gameSession = gameSessions[roomId];
-    auto& questions = roomQuestions[roomId];
-    int playerIdx = 0;
-    if (gameSession.playerQuestionIndex.count(username))
-        playerIdx = gameSession.playerQuestionIndex[username];
+    auto& gameSession = state->session;
+    auto& questions = state->questions;
+    int playerIdx = player->questionIndex;
     if (playerIdx >= static_cast<int>(questions.size())) {
         return "ERROR|No more questions|GAME_FINISHED";
     }
-    const auto& question = questions[playerIdx];
     // Calculate remaining time
     auto now = std::chrono::steady_clock::now();
+    markDelivered(*player, now);
     int secondsLeft = gameSession.gameDurationSeconds - std::chrono::duration_cast<std::chrono::seconds>(now - gameSession.gameStartTime).count();
     if (secondsLeft < 0) secondsLeft = 0;
-    std::ostringstream oss;
-    oss << "QUESTION|" << (playerIdx + 1) << "/" << gameSession.totalQuestions
-        << "|" << question.getQuestionText() << "|" << secondsLeft;
-    for (size_t i = 0; i < question.getOptions().size(); ++i) {
-        oss << "|" << (i + 1) << "." << question.getOptions()[i];
-    }
-    return oss.str();
+    frame.position = state->questionPositions[playerIdx];
+    frame.question = questions[playerIdx];
+    frame.secondsLeft = secondsLeft;
+    return "";
 }
 
-std::string GameEngine::submitAnswer(int roomId, const std::string& username, int answerIndex) {
-    if (!isGameActive(roomId)) {
+std::string GameEngine::submitAnswer(int roomId, PlayerId playerId, int answerIndex) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state)) {
         return "ERROR|No active game";
     }
-    if (isGameTimerExpired(roomId)) {
-        endRound(roomId);
+    if (isGameTimerExpired(*state)) {
+        endRound(*state);
         return "ERROR|Game timer expired|GAME_FINISHED";
     }
-    if (!isPlayerInGame(roomId, username)) {
+    PlayerSlot* player = state->findPlayer(playerId);
+    if (!player) {
         return "ERROR|Player not in game";
     }
-    auto& gameSession = gameSessions[roomId];
-    auto& questions = roomQuestions[roomId];
-    int& playerIdx = gameSession.playerQuestionIndex[username];
+    auto& questions = state->questions;
+    int& playerIdx = player->questionIndex;
     // Debug log before increment
-    std::cout << "[DEBUG] submitAnswer: username=" << username << ", BEFORE: playerQuestionIndex=" << playerIdx << ", answerIndex=" << answerIndex << std::endl;
+    DEBUG_LOG(LogLevel::DEBUG, "submitAnswer: username=" + playerDirectory.nameOf(playerId) + ", BEFORE: playerQuestionIndex="
+              + std::to_string(playerIdx) + ", answerIndex=" + std::to_string(answerIndex));
     if (playerIdx >= static_cast<int>(questions.size())) {
         return "ERROR|No more questions|GAME_FINISHED";
     }
-    const auto& question = questions[playerIdx];
+    auto now = std::chrono::steady_clock::now();
+    if (isQuestionOverdue(*state, *player, now)) {
+        return timeOutQuestion(*state, *player);
+    }
+    const Question& question = *questions[playerIdx];
     if (answerIndex < 1 || answerIndex > question.getOptionCount()) {
         return "ERROR|Invalid answer index";
     }
-    auto& scores = playerScores[roomId];
-    auto& playerScore = scores[username];
-    auto now = std::chrono::steady_clock::now();
-    auto timeDiff = std::chrono::duration_cast<std::chrono::seconds>(now - gameSession.questionStartTime);
+    // Up to 5 bonus points, falling linearly to 0 over the first 10 seconds
+    // after the player was shown the question. Answers to a question the
+    // player never fetched earn no bonus.
     int timeBonus = 0;
-    if (timeDiff.count() <= 10) { 
-        timeBonus = 5 - (timeDiff.count() / 2);
+    if (player->deliveredIndex == playerIdx) {
+        auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - player->deliveredAt).count();
+        if (elapsedMs < 10000) {
+            timeBonus = static_cast<int>((5 * (10000 - elapsedMs) + 9999) / 10000);
+        }
     }
     // Check if answer is correct
     bool correct = question.isCorrectAnswer(answerIndex - 1);
-    awardPoints(roomId, username, correct, timeBonus);
+    awardPoints(*state, *player, correct, timeBonus);
     playerIdx++;
     // Debug log after increment
-    std::cout << "[DEBUG] submitAnswer: username=" << username << ", AFTER: playerQuestionIndex=" << playerIdx << std::endl;
+    DEBUG_LOG(LogLevel::DEBUG, "submitAnswer: username=" + playerDirectory.nameOf(playerId) + ", AFTER: playerQuestionIndex="
+              + std::to_string(playerIdx));
     bool finished = (playerIdx >= static_cast<int>(questions.size()));
-    std::ostringstream oss;
-    oss << "ANSWER_RESULT|" << (correct ? "CORRECT" : "INCORRECT") 
-        << "|" << (question.getCorrectAnswerIndex() + 1)
-        << "|" << question.getCorrectAnswer() << "|" << playerScore.score;
-    if (finished) {
-        oss << "|GAME_FINISHED";
-    }
-    return oss.str();
+    return formatAnswerResult(question, correct ? "CORRECT" : "INCORRECT", *player, finished);
 }
 
-std::string GameEngine::getGameInfo(int roomId, const std::string& /*username*/) {
-    auto it = gameSessions.find(roomId);
-    if (it == gameSessions.end()) {
+std::string GameEngine::getGameInfo(int roomId, PlayerId player) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!state) {
         return "NO_GAME";
     }
-    
+
     std::ostringstream oss;
-    oss << "GAME_INFO|" << getGameStatus(roomId);
-    
-    
-    auto players = getActivePlayers(roomId);
-    oss << "|Players:" << players.size();
-    
-    
-    oss << "|" << getLeaderboard(roomId);
-    
+    oss << "GAME_INFO|" << getGameStatus(*state);
+
+    oss << "|Players:" << state->players.size();
+
+    oss << "|" << getLeaderboard(state, player);
+
     return oss.str();
 }
 
-std::string GameEngine::getLeaderboard(int roomId, const std::string& /*username*/) {
-    return getLeaderboard(roomId);
+std::string GameEngine::getLeaderboard(int roomId, PlayerId player) {
+    return getLeaderboard(findRoomState(roomId), player);
 }
 
-bool GameEngine::isPlayerInGame(int roomId, const std::string& username) {
-    auto it = roomPlayers.find(roomId);
-    if (it == roomPlayers.end()) {
-        return false;
-    }
-    
-    return std::find(it->second.begin(), it->second.end(), username) != it->second.end();
+bool GameEngine::isPlayerInGame(int roomId, PlayerId player) {
+    RoomGameState* state = findRoomState(roomId);
+    return state && state->findPlayer(player) != nullptr;
 }
 
-bool GameEngine::canStartGame(int roomId, const std::string& username) {
+bool GameEngine::canStartGame(int roomId, PlayerId player) {
     auto room = roomManager.getRoom(roomId);
-    return room && room->getHostUsername() == username && !isGameActive(roomId);
+    return room && room->getHostId() == player && !isGameActive(findRoomState(roomId));
 }
 
 int GameEngine::getPlayerCount(int roomId) {
-    auto it = roomPlayers.find(roomId);
-    return it != roomPlayers.end() ? it->second.size() : 0;
+    RoomGameState* state = findRoomState(roomId);
+    return state ? state->players.size() : 0;
 }
 
-std::vector<std::string> GameEngine::getActivePlayers(int roomId) {
-    auto it = roomPlayers.find(roomId);
-    return it != roomPlayers.end() ? it->second : std::vector<std::string>();
+std::vector<PlayerId> GameEngine::getActivePlayers(int roomId) {
+    std::vector<PlayerId> players;
+    RoomGameState* state = findRoomState(roomId);
+    if (state) {
+        for (const auto& player : state->players) {
+            players.push_back(player.score.playerId);
+        }
+    }
+    return players;
 }
 
-void GameEngine::removePlayer(int roomId, const std::string& username) {
-    
-    auto it = roomPlayers.find(roomId);
-    if (it != roomPlayers.end()) {
-        auto& players = it->second;
-        players.erase(std::remove(players.begin(), players.end(), username), players.end());
+void GameEngine::removePlayer(int roomId, PlayerId player) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!state) {
+        return;
     }
-    
 
-    auto scoreIt = playerScores.find(roomId);
-    if (scoreIt != playerScores.end()) {
-        scoreIt->second.erase(username);
+    auto it = state->playerIndex.find(player);
+    if (it == state->playerIndex.end()) {
+        return;
     }
-    
+    // Fill the gap with the last slot so removal is O(1)
+    size_t position = it->second;
+    state->playerIndex.erase(it);
+    state->leaderboard.remove(player);
+    auto& players = state->players;
+    if (position != players.size() - 1) {
+        players[position] = players.back();
+        state->playerIndex[players[position].score.playerId] = position;
+    }
+    players.pop_back();
 
-    if (getPlayerCount(roomId) == 0) {
+    if (players.empty()) {
         cleanupRoom(roomId);
     }
 }
 
 void GameEngine::cleanupRoom(int roomId) {
-    gameSessions.erase(roomId);
-    playerScores.erase(roomId);
-    roomQuestions.erase(roomId);
-    roomPlayers.erase(roomId);
-} 
+    auto it = roomStateIndex.find(roomId);
+    if (it == roomStateIndex.end()) {
+        return;
+    }
+    // Keep storage dense: move the last room into the freed position
+    size_t position = it->second;
+    roomStateIndex.erase(it);
+    if (position != roomStates.size() - 1) {
+        roomStates[position] = std::move(roomStates.back());
+        roomStateIndex[roomStates[position].roomId] = position;
+    }
+    roomStates.pop_back();
+}
 
-bool GameEngine::isGameTimerExpired(int roomId) {
-    auto it = gameSessions.find(roomId);
-    if (it == gameSessions.end()) return true;
-    const auto& gameSession = it->second;
+bool GameEngine::isGameTimerExpired(const RoomGameState& state) const {
+    const auto& gameSession = state.session;
     if (gameSession.currentState != GameSession::PLAYING) return false;
     auto now = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - gameSession.gameStartTime).count();
     return elapsed >= gameSession.gameDurationSeconds;
-} 
\ No newline at end of file
+}
+
+bool GameEngine::getGameDeadline(int roomId, std::chrono::steady_clock::time_point& deadline) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state)) {
+        return false;
+    }
+    deadline = state->session.gameStartTime + std::chrono::seconds(state->session.gameDurationSeconds);
+    return true;
+}
+
+std::string GameEngine::expireGame(int roomId) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!state || state->session.currentState == GameSession::WAITING) {
+        return "";
+    }
+    endRound(*state);
+    return getLeaderboard(state);
+}
+
+bool GameEngine::getQuestionDeadline(int roomId, PlayerId playerId, QuestionDeadline& deadline) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state) || state->session.questionTimeLimit <= 0) {
+        return false;
+    }
+    PlayerSlot* player = state->findPlayer(playerId);
+    if (!player || player->deliveredIndex != player->questionIndex
+        || player->questionIndex >= static_cast<int>(state->questions.size())) {
+        return false;
+    }
+    deadline.questionIndex = player->questionIndex;
+    deadline.deliveredAt = player->deliveredAt;
+    deadline.deadline = player->deliveredAt + std::chrono::seconds(state->session.questionTimeLimit);
+    return true;
+}
+
+std::string GameEngine::expireQuestion(int roomId, PlayerId playerId, const QuestionDeadline& deadline) {
+    RoomGameState* state = findRoomState(roomId);
+    if (!isGameActive(state)) {
+        return "";
+    }
+    PlayerSlot* player = state->findPlayer(playerId);
+    // Only if the player is still on the same delivery of the same question
+    if (!player || player->questionIndex != deadline.questionIndex || player->deliveredIndex != deadline.questionIndex
+        || player->deliveredAt != deadline.deliveredAt) {
+        return "";
+    }
+    return timeOutQuestion(*state, *player);
+}
+
+bool GameEngine::isGameTimerExpired(int roomId) {
+    RoomGameState* state = findRoomState(roomId);
+    return !state || isGameTimerExpired(*state);
+}
+
+void GameEngine::saveGame(int roomId, SnapshotEncoder& out) const {
+    auto it = roomStateIndex.find(roomId);
+    if (it == roomStateIndex.end()) {
+        out.addU8(0);
+        return;
+    }
+    const RoomGameState& state = roomStates[it->second];
+    const GameSession& gameSession = state.session;
+    out.addU8(1).addU8(static_cast<uint8_t>(gameSession.currentState)).addU8(state.arena ? 1 : 0)
+       .addI32(gameSession.currentQuestionIndex).addI32(gameSession.gameDurationSeconds)
+       .addI32(gameSession.questionTimeLimit).addTime(gameSession.gameStartTime);
+    out.addU32(static_cast<uint32_t>(state.questions.size()));
+    for (const QuestionHandle& question : state.questions) {
+        out.addI32(question->getQuestionId());
+    }
+    out.addU32(static_cast<uint32_t>(state.players.size()));
+    for (const PlayerSlot& player : state.players) {
+        const PlayerScore& score = player.score;
+        out.addString(playerDirectory.nameOf(score.playerId)).addI32(player.questionIndex)
+           .addI32(player.deliveredIndex).addTime(player.deliveredAt)
+           .addI32(score.score).addI32(score.correctAnswers).addI32(score.totalAnswers);
+    }
+}
+
+bool GameEngine::restoreGame(int roomId, SnapshotDecoder& in, PlayerDirectory& directory) {
+    uint8_t hasGame = 0;
+    if (!in.readU8(hasGame) || hasGame == 0) {
+        return in.ok();
+    }
+    RoomGameState state;
+    state.roomId = roomId;
+    uint8_t currentState = 0, arena = 0;
+    int32_t currentQuestionIndex = 0, gameDurationSeconds = 0, questionTimeLimit = 0;
+    uint32_t questionCount = 0;
+    in.readU8(currentState);
+    in.readU8(arena);
+    in.readI32(currentQuestionIndex);
+    in.readI32(gameDurationSeconds);
+    in.readI32(questionTimeLimit);
+    in.readTime(state.session.gameStartTime);
+    in.readCount(questionCount, 4);
+    if (!in.ok() || currentState > GameSession::FINISHED || findRoomState(roomId)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < questionCount; ++i) {
+        int32_t questionId = 0;
+        if (!in.readI32(questionId)) {
+            return false;
+        }
+        QuestionHandle question = questionManager.getQuestion(questionId);
+        if (!question) {
+            std::cerr << "Question " << questionId << " of the game in room " << roomId
+                      << " is no longer in the bank." << std::endl;
+            return false;
+        }
+        state.questions.push_back(std::move(question));
+        state.questionPositions.push_back(std::make_shared<const std::string>(
+            "QUESTION|" + std::to_string(i + 1) + "/" + std::to_string(questionCount)));
+    }
+    auto& gameSession = state.session;
+    gameSession.currentState = static_cast<GameSession::State>(currentState);
+    gameSession.currentQuestionIndex = currentQuestionIndex;
+    gameSession.totalQuestions = static_cast<int>(questionCount);
+    gameSession.gameDurationSeconds = gameDurationSeconds;
+    gameSession.questionTimeLimit = questionTimeLimit;
+    gameSession.roundStartTime = gameSession.gameStartTime;
+    gameSession.questionStartTime = gameSession.gameStartTime;
+    state.arena = (arena != 0);
+
+    uint32_t playerCount = 0;
+    if (!in.readCount(playerCount, 28)) {
+        return false;
+    }
+    state.players.resize(playerCount);
+    state.playerIndex.reserve(playerCount);
+    for (uint32_t i = 0; i < playerCount; ++i) {
+        PlayerSlot& player = state.players[i];
+        PlayerScore& score = player.score;
+        std::string name;
+        in.readString(name);
+        in.readI32(player.questionIndex);
+        in.readI32(player.deliveredIndex);
+        in.readTime(player.deliveredAt);
+        in.readI32(score.score);
+        in.readI32(score.correctAnswers);
+        in.readI32(score.totalAnswers);
+        if (!in.ok() || player.questionIndex < 0 || player.questionIndex > static_cast<int>(questionCount)) {
+            return false;
+        }
+        score.playerId = directory.intern(name);
+        if (!state.playerIndex.emplace(score.playerId, i).second) {
+            return false;
+        }
+        state.leaderboard.add(score.playerId, &directory.nameOf(score.playerId));
+        state.leaderboard.update(score.playerId, score.score, score.correctAnswers, score.totalAnswers);
+    }
+
+    roomStateIndex[roomId] = roomStates.size();
+    roomStates.push_back(std::move(state));
+    return true;
+}
@@ -3,20 +3,21 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
 #include <memory>
 #include <chrono>
 #include "room_manager.h"
 #include "question_manager.h"
+#include "leaderboard.h"
 
 struct PlayerScore {
-    std::string username;
+    PlayerId playerId;
     int score;
     int correctAnswers;
     int totalAnswers;
     std::chrono::steady_clock::time_point lastAnswerTime;
     
-    PlayerScore() : score(0), correctAnswers(0), totalAnswers(0) {}
+    PlayerScore() : playerId(INVALID_PLAYER_ID), score(0), correctAnswers(0), totalAnswers(0) {}
 };
 
 struct GameSession {
@@ -35,52 +36,125 @@ struct GameSession {
     int questionTimeLimit;
     int gameDurationSeconds;
     std::chrono::steady_clock::time_point gameStartTime;
-    std::map<std::string, int> playerQuestionIndex;
     
     GameSession() : currentState(WAITING), currentQuestionIndex(0), 
                     totalQuestions(0), roundTimeLimit(300), questionTimeLimit(30),
                     gameDurationSeconds(90) {}
 };
 
+// One player's score and progress through the room's question list
+struct PlayerSlot {
+    PlayerScore score;
+    int questionIndex;
+    int deliveredIndex;   // question the player has been shown, -1 if none yet
+    std::chrono::steady_clock::time_point deliveredAt;
+
+    PlayerSlot() : questionIndex(0), deliveredIndex(-1) {}
+};
+
+// Time limit of one delivery of a question to a player
+struct QuestionDeadline {
+    int questionIndex;
+    std::chrono::steady_clock::time_point deliveredAt;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// A QUESTION reply in pieces. position and the question's segments are
+// shared, so sending it to any number of players copies no question text.
+struct QuestionFrame {
+    std::shared_ptr<const std::string> position;   // "QUESTION|i/n"
+    QuestionHandle question;
+    int secondsLeft;
+
+    QuestionFrame() : secondsLeft(0) {}
+};
+
+// Everything the engine knows about one room's game, kept together so a
+// command needs a single lookup
+struct RoomGameState {
+    int roomId;
+    GameSession session;
+    std::vector<QuestionHandle> questions;   // shared with the question bank
+    std::vector<std::shared_ptr<const std::string>> questionPositions;   // "QUESTION|i/n" per question
+    std::vector<PlayerSlot> players;
+    std::unordered_map<PlayerId, size_t> playerIndex;   // position of each player in players
+    Leaderboard leaderboard;           // updated on every answer
+    bool arena;                        // leaderboards show the top N plus the reader
+
+    RoomGameState() : roomId(-1), arena(false) {}
+
+    PlayerSlot* findPlayer(PlayerId player);
+};
+
 class GameEngine {
 private:
-    std::map<int, GameSession> gameSessions; 
-    std::map<int, std::map<std::string, PlayerScore>> playerScores; // roomId -> {username -> score}
-    std::map<int, std::vector<Question>> roomQuestions; 
-    std::map<int, std::vector<std::string>> roomPlayers; 
+    // Dense storage; roomStateIndex maps roomId to a position in roomStates
+    std::vector<RoomGameState> roomStates;
+    std::unordered_map<int, size_t> roomStateIndex;
     
     RoomManager& roomManager;
     QuestionManager& questionManager;
+    const PlayerDirectory& playerDirectory;   // names are only needed for leaderboards
     
-    bool isGameActive(int roomId);
-    void startNewRound(int roomId);
-    void endRound(int roomId);
-    std::string getGameStatus(int roomId);
-    std::string getLeaderboard(int roomId);
-    void awardPoints(int roomId, const std::string& username, bool correct, int timeBonus = 0);
+    RoomGameState* findRoomState(int roomId);
+    bool isGameActive(const RoomGameState* state) const;
+    bool isGameTimerExpired(const RoomGameState& state) const;
+    void startNewRound(RoomGameState& state);
+    void endRound(RoomGameState& state);
+    std::string getGameStatus(const RoomGameState& state) const;
+    std::string getLeaderboard(const RoomGameState* state, PlayerId reader = INVALID_PLAYER_ID) const;
+    void awardPoints(RoomGameState& state, PlayerSlot& player, bool correct, int timeBonus = 0);
+    void markDelivered(PlayerSlot& player, std::chrono::steady_clock::time_point now);
+    bool isQuestionOverdue(const RoomGameState& state, const PlayerSlot& player,
+                           std::chrono::steady_clock::time_point now) const;
+    std::string timeOutQuestion(RoomGameState& state, PlayerSlot& player);
+    std::string formatAnswerResult(const Question& question, const char* verdict,
+                                   const PlayerSlot& player, bool finished) const;
+
+    bool questionDeadlines;   // enforce GameConstants::QUESTION_TIME_LIMIT_SECONDS per question
     
 public:
-    GameEngine(RoomManager& rm, QuestionManager& qm);
+    GameEngine(RoomManager& rm, QuestionManager& qm, const PlayerDirectory& pd);
     ~GameEngine();
     
     // Game control
-    std::string startGame(int roomId, const std::string& username, int questionCount = 10);
-    std::string endGame(int roomId, const std::string& username);
-    std::string getCurrentQuestion(int roomId, const std::string& username);
-    std::string submitAnswer(int roomId, const std::string& username, int answerIndex);
-    std::string getGameInfo(int roomId, const std::string& username);
-    std::string getLeaderboard(int roomId, const std::string& username);
+    std::string startGame(int roomId, PlayerId player, int questionCount = 10);
+    std::string endGame(int roomId, PlayerId player);
+    // Fills frame with the player's current question and returns "", or
+    // returns the error reply if there is none
+    std::string getCurrentQuestion(int roomId, PlayerId player, QuestionFrame& frame);
+    std::string submitAnswer(int roomId, PlayerId player, int answerIndex);
+    std::string getGameInfo(int roomId, PlayerId player);
+    std::string getLeaderboard(int roomId, PlayerId player);
     
     // Game state queries
-    bool isPlayerInGame(int roomId, const std::string& username);
-    bool canStartGame(int roomId, const std::string& username);
+    bool isPlayerInGame(int roomId, PlayerId player);
+    bool canStartGame(int roomId, PlayerId player);
     int getPlayerCount(int roomId);
-    std::vector<std::string> getActivePlayers(int roomId);
+    std::vector<PlayerId> getActivePlayers(int roomId);
     
-    void removePlayer(int roomId, const std::string& username);
+    void removePlayer(int roomId, PlayerId player);
     void cleanupRoom(int roomId);
 
     bool isGameTimerExpired(int roomId);
+
+    // Snapshot support: appends the room's game, or a marker that there is
+    // none. Questions are saved by id and looked up again on restore;
+    // restoreGame fails if the bank no longer has one of them.
+    void saveGame(int roomId, SnapshotEncoder& out) const;
+    bool restoreGame(int roomId, SnapshotDecoder& in, PlayerDirectory& directory);
+
+    void setQuestionDeadlines(bool enabled) { questionDeadlines = enabled; }
+    // Deadline of the question the player was last shown, if it has one and is unanswered
+    bool getQuestionDeadline(int roomId, PlayerId player, QuestionDeadline& deadline);
+    // Called when that deadline passes: counts the question as missed, moves
+    // the player on and returns the result to send, or "" if they already answered
+    std::string expireQuestion(int roomId, PlayerId player, const QuestionDeadline& deadline);
+    // When the running game in the room runs out of time; false if none is running
+    bool getGameDeadline(int roomId, std::chrono::steady_clock::time_point& deadline);
+    // Called when the deadline passes: finishes the game and returns the
+    // final leaderboard, or "" if the game is already gone
+    std::string expireGame(int roomId);
 };
 
 #endif
\ No newline at end of file
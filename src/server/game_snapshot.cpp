@@ -0,0 +1,285 @@
+#include "game_snapshot.h"
+#include "durable_file.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+
+namespace {
+    // File: magic, room count, then per room its id, record length and
+    // record; session record count and the records; a CRC32 of everything
+    // before it
+    const char MAGIC[8] = {'Q', 'G', 'S', 'N', 'A', 'P', '0', '1'};
+
+    std::chrono::system_clock::duration wallClockOffset() {
+        return std::chrono::system_clock::now().time_since_epoch()
+               - std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                     std::chrono::steady_clock::now().time_since_epoch());
+    }
+}
+
+SnapshotEncoder::SnapshotEncoder(std::string& bytes) : out(bytes), wallOffset(wallClockOffset()) {
+}
+
+SnapshotEncoder& SnapshotEncoder::addU8(uint8_t value) {
+    out.push_back(static_cast<char>(value));
+    return *this;
+}
+
+SnapshotEncoder& SnapshotEncoder::addU32(uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, sizeof(bytes));
+    return *this;
+}
+
+SnapshotEncoder& SnapshotEncoder::addI64(int64_t value) {
+    uint64_t bits = static_cast<uint64_t>(value);
+    addU32(static_cast<uint32_t>(bits));
+    return addU32(static_cast<uint32_t>(bits >> 32));
+}
+
+SnapshotEncoder& SnapshotEncoder::addString(const std::string& value) {
+    addU32(static_cast<uint32_t>(value.size()));
+    out.append(value);
+    return *this;
+}
+
+SnapshotEncoder& SnapshotEncoder::addTime(std::chrono::steady_clock::time_point value) {
+    auto wall = std::chrono::duration_cast<std::chrono::system_clock::duration>(value.time_since_epoch()) + wallOffset;
+    return addI64(std::chrono::duration_cast<std::chrono::milliseconds>(wall).count());
+}
+
+SnapshotDecoder::SnapshotDecoder(const char* bytes, size_t length)
+    : data(bytes), size(length), offset(0), failed(false), wallOffset(wallClockOffset()) {
+}
+
+const char* SnapshotDecoder::take(size_t length) {
+    if (failed || size - offset < length) {
+        failed = true;
+        return nullptr;
+    }
+    const char* bytes = data + offset;
+    offset += length;
+    return bytes;
+}
+
+bool SnapshotDecoder::readU8(uint8_t& value) {
+    const char* bytes = take(1);
+    if (bytes) {
+        value = static_cast<uint8_t>(bytes[0]);
+    }
+    return bytes != nullptr;
+}
+
+bool SnapshotDecoder::readU32(uint32_t& value) {
+    const char* bytes = take(4);
+    if (!bytes) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return true;
+}
+
+bool SnapshotDecoder::readI32(int32_t& value) {
+    uint32_t bits = 0;
+    if (!readU32(bits)) {
+        return false;
+    }
+    value = static_cast<int32_t>(bits);
+    return true;
+}
+
+bool SnapshotDecoder::readI64(int64_t& value) {
+    uint32_t low = 0, high = 0;
+    if (!readU32(low) || !readU32(high)) {
+        return false;
+    }
+    value = static_cast<int64_t>((static_cast<uint64_t>(high) << 32) | low);
+    return true;
+}
+
+bool SnapshotDecoder::readString(std::string& value) {
+    uint32_t length = 0;
+    if (!readU32(length)) {
+        return false;
+    }
+    const char* bytes = take(length);
+    if (!bytes) {
+        return false;
+    }
+    value.assign(bytes, length);
+    return true;
+}
+
+bool SnapshotDecoder::readTime(std::chrono::steady_clock::time_point& value) {
+    int64_t wallMilliseconds = 0;
+    if (!readI64(wallMilliseconds)) {
+        return false;
+    }
+    auto steady = std::chrono::milliseconds(wallMilliseconds) - wallOffset;
+    value = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(steady));
+    return true;
+}
+
+bool SnapshotDecoder::readCount(uint32_t& count, size_t minItemBytes) {
+    if (!readU32(count)) {
+        return false;
+    }
+    if (minItemBytes > 0 && count > (size - offset) / minItemBytes) {
+        failed = true;
+    }
+    return !failed;
+}
+
+GameSnapshotStore::GameSnapshotStore(const std::string& file)
+    : path(file), version(0), writtenVersion(0), stopping(false) {
+}
+
+GameSnapshotStore::~GameSnapshotStore() {
+    stop();
+}
+
+bool GameSnapshotStore::load(std::vector<std::pair<int, std::string>>& loaded,
+                             std::vector<std::string>& loadedSessions) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string bytes = contents.str();
+
+    if (bytes.size() < sizeof(MAGIC) + 8 || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Game snapshot " << path << " is not a snapshot file; ignoring it." << std::endl;
+        return false;
+    }
+    size_t bodySize = bytes.size() - 4;
+    SnapshotDecoder trailer(bytes.data() + bodySize, 4);
+    uint32_t storedCrc = 0;
+    if (!trailer.readU32(storedCrc) || storedCrc != DurableFile::crc32(bytes.data(), bodySize)) {
+        std::cerr << "Game snapshot " << path << " is damaged; ignoring it." << std::endl;
+        return false;
+    }
+
+    SnapshotDecoder in(bytes.data() + sizeof(MAGIC), bodySize - sizeof(MAGIC));
+    uint32_t count = 0;
+    in.readCount(count, 8);
+    loaded.clear();
+    loaded.reserve(count);
+    for (uint32_t i = 0; i < count && in.ok(); ++i) {
+        int32_t roomId = 0;
+        std::string record;
+        if (in.readI32(roomId) && in.readString(record)) {
+            loaded.emplace_back(roomId, std::move(record));
+        }
+    }
+    in.readCount(count, 4);
+    loadedSessions.clear();
+    for (uint32_t i = 0; i < count && in.ok(); ++i) {
+        std::string record;
+        if (in.readString(record)) {
+            loadedSessions.push_back(std::move(record));
+        }
+    }
+    if (!in.ok() || !in.atEnd()) {
+        std::cerr << "Game snapshot " << path << " is malformed; ignoring it." << std::endl;
+        loaded.clear();
+        loadedSessions.clear();
+        return false;
+    }
+    return true;
+}
+
+void GameSnapshotStore::start() {
+    if (!writer.joinable()) {
+        writer = std::thread([this]() { writerLoop(); });
+    }
+}
+
+void GameSnapshotStore::update(std::vector<std::pair<int, Record>>& changes) {
+    if (changes.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& change : changes) {
+            if (change.second) {
+                rooms[change.first] = std::move(change.second);
+            } else {
+                rooms.erase(change.first);
+            }
+        }
+        ++version;
+    }
+    changes.clear();
+    wakeWriter.notify_one();
+}
+
+void GameSnapshotStore::updateSessions(int shard, Record record) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sessions[shard] = std::move(record);
+        ++version;
+    }
+    wakeWriter.notify_one();
+}
+
+void GameSnapshotStore::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+// Updates that arrive while a file is being written are picked up by the
+// next one, so the writer never falls more than one file behind
+void GameSnapshotStore::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeWriter.wait(lock, [this]() { return stopping || version != writtenVersion; });
+        if (version == writtenVersion) {
+            return;
+        }
+        std::map<int, Record> roomRecords = rooms;
+        std::map<int, Record> sessionRecords = sessions;
+        uint64_t snapshotVersion = version;
+        lock.unlock();
+        bool written = writeFile(roomRecords, sessionRecords);
+        lock.lock();
+        if (!written) {
+            std::cerr << "Could not write game snapshot " << path << "." << std::endl;
+        }
+        if (written || stopping) {
+            writtenVersion = snapshotVersion;
+        } else {
+            // Retry after a pause rather than spinning on a full or read-only disk
+            wakeWriter.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping; });
+        }
+    }
+}
+
+bool GameSnapshotStore::writeFile(const std::map<int, Record>& roomRecords,
+                                  const std::map<int, Record>& sessionRecords) const {
+    std::string bytes(MAGIC, sizeof(MAGIC));
+    SnapshotEncoder out(bytes);
+    out.addU32(static_cast<uint32_t>(roomRecords.size()));
+    for (const auto& room : roomRecords) {
+        out.addI32(room.first).addString(*room.second);
+    }
+    out.addU32(static_cast<uint32_t>(sessionRecords.size()));
+    for (const auto& shard : sessionRecords) {
+        out.addString(*shard.second);
+    }
+    out.addU32(DurableFile::crc32(bytes.data(), bytes.size()));
+    return DurableFile::replace(path, bytes);
+}
@@ -0,0 +1,108 @@
+#ifndef GAME_SNAPSHOT_H
+#define GAME_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Appends fixed-width little-endian fields to a snapshot record. Times are
+// stored as wall-clock milliseconds so they mean the same after a restart.
+class SnapshotEncoder {
+public:
+    explicit SnapshotEncoder(std::string& out);
+
+    SnapshotEncoder& addU8(uint8_t value);
+    SnapshotEncoder& addU32(uint32_t value);
+    SnapshotEncoder& addI32(int32_t value) { return addU32(static_cast<uint32_t>(value)); }
+    SnapshotEncoder& addI64(int64_t value);
+    SnapshotEncoder& addString(const std::string& value);
+    SnapshotEncoder& addTime(std::chrono::steady_clock::time_point value);
+
+private:
+    std::string& out;
+    std::chrono::system_clock::duration wallOffset;   // wall clock minus steady clock, read once
+};
+
+// Reads fields back in the order they were added. A read past the end, or
+// of a length that does not fit, fails this and every later read.
+class SnapshotDecoder {
+public:
+    SnapshotDecoder(const char* data, size_t size);
+    explicit SnapshotDecoder(const std::string& bytes) : SnapshotDecoder(bytes.data(), bytes.size()) {}
+
+    bool readU8(uint8_t& value);
+    bool readU32(uint32_t& value);
+    bool readI32(int32_t& value);
+    bool readI64(int64_t& value);
+    bool readString(std::string& value);
+    bool readTime(std::chrono::steady_clock::time_point& value);
+    // A count of items that each take at least minItemBytes; rejects counts
+    // the remaining bytes cannot hold, so a damaged record cannot make the
+    // reader reserve huge amounts of memory
+    bool readCount(uint32_t& count, size_t minItemBytes);
+
+    bool ok() const { return !failed; }
+    bool atEnd() const { return offset == size; }
+
+private:
+    const char* data;
+    size_t size;
+    size_t offset;
+    bool failed;
+    std::chrono::system_clock::duration wallOffset;
+
+    const char* take(size_t length);
+};
+
+// Periodic snapshots of the games in progress, so a restart does not end
+// them. Each shard encodes the rooms it owns into one record per room, and
+// the resumable sessions of their players into one record per shard; a
+// tick re-encodes only the records that changed since the last one. Records
+// are immutable once built: the store holds them by shared_ptr, and its
+// writer thread copies the pointers under the lock and writes a new file
+// outside it (checksummed, via a temporary file, fsync and rename), so an
+// event loop never waits on the disk.
+class GameSnapshotStore {
+public:
+    typedef std::shared_ptr<const std::string> Record;
+
+    explicit GameSnapshotStore(const std::string& path);
+    ~GameSnapshotStore();
+
+    // Reads the snapshot left by the previous run: (roomId, record) pairs
+    // and the shards' session records. False if there is none or it is
+    // damaged; call before start()
+    bool load(std::vector<std::pair<int, std::string>>& rooms, std::vector<std::string>& sessions) const;
+    void start();
+    // Thread-safe: replaces the records of the given rooms, or drops a room
+    // whose record is null, and wakes the writer
+    void update(std::vector<std::pair<int, Record>>& changes);
+    // Thread-safe: replaces the session record of a shard
+    void updateSessions(int shard, Record record);
+    // Writes any changes not yet on disk, then stops the writer
+    void stop();
+
+private:
+    std::string path;
+
+    std::mutex mutex;
+    std::condition_variable wakeWriter;
+    std::map<int, Record> rooms;
+    std::map<int, Record> sessions;   // by shard
+    uint64_t version;          // bumped by every update
+    uint64_t writtenVersion;   // version of the last file written
+    bool stopping;
+    std::thread writer;
+
+    void writerLoop();
+    bool writeFile(const std::map<int, Record>& roomRecords, const std::map<int, Record>& sessionRecords) const;
+};
+
+#endif
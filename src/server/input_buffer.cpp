@@ -0,0 +1,81 @@
+#include "input_buffer.h"
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+
+namespace {
+    const size_t INITIAL_CAPACITY = 1024;
+    const size_t MIN_READ_SIZE = 512;
+}
+
+InputBuffer::InputBuffer(size_t maxSize)
+    : readPos(0), scanPos(0), writePos(0), maxFrameSize(maxSize), frameTooLong(false) {
+}
+
+// Move unconsumed bytes to the front, growing only when a long frame needs it
+void InputBuffer::makeRoom() {
+    if (data.empty()) {
+        data.resize(INITIAL_CAPACITY);
+    }
+    if (data.size() - writePos >= MIN_READ_SIZE) {
+        return;
+    }
+    if (readPos > 0) {
+        size_t pending = writePos - readPos;
+        std::memmove(data.data(), data.data() + readPos, pending);
+        scanPos -= readPos;
+        writePos = pending;
+        readPos = 0;
+    }
+    // Room for one full frame plus its newline and a minimum read
+    if (data.size() - writePos < MIN_READ_SIZE && data.size() < maxFrameSize + MIN_READ_SIZE + 1) {
+        data.resize(std::min(data.size() * 2, maxFrameSize + MIN_READ_SIZE + 1));
+    }
+}
+
+InputBuffer::ReadResult InputBuffer::readFrom(int socket) {
+    makeRoom();
+    while (true) {
+        ssize_t recvLen = recv(socket, data.data() + writePos, data.size() - writePos, 0);
+        if (recvLen > 0) {
+            writePos += static_cast<size_t>(recvLen);
+            return ReadResult::DATA;
+        }
+        if (recvLen == 0) {
+            return ReadResult::CLOSED;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return (errno == EWOULDBLOCK || errno == EAGAIN) ? ReadResult::WOULD_BLOCK : ReadResult::ERROR;
+    }
+}
+
+bool InputBuffer::nextFrame(std::string_view& frame) {
+    if (scanPos == writePos || frameTooLong) {
+        return false;
+    }
+    const char* begin = data.data();
+    const void* newline = std::memchr(begin + scanPos, '\n', writePos - scanPos);
+    if (!newline) {
+        scanPos = writePos;
+        return false;
+    }
+    size_t end = static_cast<const char*>(newline) - begin;
+    size_t length = end - readPos;
+    if (length > maxFrameSize) {
+        frameTooLong = true;
+        return false;
+    }
+    if (length > 0 && begin[end - 1] == '\r') {
+        --length;
+    }
+    frame = std::string_view(begin + readPos, length);
+    readPos = scanPos = end + 1;
+    if (readPos == writePos) {
+        readPos = scanPos = writePos = 0;
+    }
+    return true;
+}
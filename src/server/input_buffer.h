@@ -0,0 +1,44 @@
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+// Per-connection receive buffer that splits the TCP byte stream into
+// newline-delimited frames. Partial frames are kept across reads and the
+// storage is reused, so steady-state reads do not allocate.
+class InputBuffer {
+public:
+    enum class ReadResult {
+        DATA,
+        WOULD_BLOCK,
+        CLOSED,
+        ERROR
+    };
+
+    explicit InputBuffer(size_t maxFrameSize);
+
+    // One recv() into the free space at the end of the buffer
+    ReadResult readFrom(int socket);
+
+    // Extracts the next complete frame without its "\n" (or "\r\n").
+    // The view stays valid until the next readFrom().
+    bool nextFrame(std::string_view& frame);
+
+    // True once a frame, complete or not, is longer than the frame limit
+    bool overflowed() const { return frameTooLong || writePos - readPos > maxFrameSize; }
+    size_t size() const { return writePos - readPos; }
+
+private:
+    std::vector<char> data;
+    size_t readPos;    // start of unconsumed bytes
+    size_t scanPos;    // bytes before this are known not to contain '\n'
+    size_t writePos;   // end of received bytes
+    size_t maxFrameSize;
+    bool frameTooLong;
+
+    void makeRoom();
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include "leaderboard.h"
+
+Leaderboard::Leaderboard() : ranking(new RankTree()), cacheValid(false), topCacheLimit(0) {
+}
+
+void Leaderboard::clear() {
+    ranking->clear();
+    entries.clear();
+    cacheValid = false;
+    topCacheLimit = 0;
+}
+
+void Leaderboard::add(PlayerId player, const std::string* name) {
+    if (entries.count(player)) {
+        return;
+    }
+    Key key{0, 0, name, player};
+    ranking->insert(std::make_pair(key, 0));
+    entries.emplace(player, key);
+    cacheValid = false;
+    topCacheLimit = 0;
+}
+
+void Leaderboard::remove(PlayerId player) {
+    auto it = entries.find(player);
+    if (it == entries.end()) {
+        return;
+    }
+    ranking->erase(it->second);
+    entries.erase(it);
+    cacheValid = false;
+    topCacheLimit = 0;
+}
+
+void Leaderboard::update(PlayerId player, int score, int correctAnswers, int totalAnswers) {
+    auto it = entries.find(player);
+    if (it == entries.end()) {
+        return;
+    }
+    Key& key = it->second;
+    if (key.score != score || key.correctAnswers != correctAnswers) {
+        ranking->erase(key);
+        key.score = score;
+        key.correctAnswers = correctAnswers;
+        ranking->insert(std::make_pair(key, totalAnswers));
+    } else {
+        (*ranking)[key] = totalAnswers;
+    }
+    cacheValid = false;
+    topCacheLimit = 0;
+}
+
+size_t Leaderboard::rankOf(PlayerId player) const {
+    auto it = entries.find(player);
+    if (it == entries.end()) {
+        return 0;
+    }
+    return ranking->order_of_key(it->second) + 1;
+}
+
+void Leaderboard::appendEntry(std::string& out, size_t rank, const Key& key, int totalAnswers) const {
+    out += '|';
+    out += std::to_string(rank);
+    out += '.';
+    out += *key.name;
+    out += ':';
+    out += std::to_string(key.score);
+    out += '(';
+    out += std::to_string(key.correctAnswers);
+    out += '/';
+    out += std::to_string(totalAnswers);
+    out += ')';
+}
+
+const std::string& Leaderboard::serialized() const {
+    if (!cacheValid) {
+        cache.clear();
+        size_t rank = 1;
+        for (auto it = ranking->begin(); it != ranking->end(); ++it, ++rank) {
+            appendEntry(cache, rank, it->first, it->second);
+        }
+        cacheValid = true;
+    }
+    return cache;
+}
+
+const std::string& Leaderboard::serializedTop(size_t limit) const {
+    if (topCacheLimit != limit) {
+        topCache.clear();
+        size_t rank = 1;
+        for (auto it = ranking->begin(); it != ranking->end() && rank <= limit; ++it, ++rank) {
+            appendEntry(topCache, rank, it->first, it->second);
+        }
+        topCacheLimit = limit;
+    }
+    return topCache;
+}
+
+void Leaderboard::appendPlayer(std::string& out, PlayerId player) const {
+    auto it = entries.find(player);
+    if (it == entries.end()) {
+        return;
+    }
+    auto node = ranking->find(it->second);
+    appendEntry(out, ranking->order_of_key(it->second) + 1, node->first, node->second);
+}
@@ -0,0 +1,67 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include "../common/player_id.h"
+
+// Ranking of one room's players, kept ordered as scores change so reading
+// it never sorts. Order: score, then correct answers (both descending),
+// then name. The serialized form is cached until the next change.
+class Leaderboard {
+public:
+    Leaderboard();
+
+    void clear();
+    // name must outlive the leaderboard (PlayerDirectory names do)
+    void add(PlayerId player, const std::string* name);
+    void remove(PlayerId player);
+    void update(PlayerId player, int score, int correctAnswers, int totalAnswers);
+
+    size_t size() const { return entries.size(); }
+    // 1-based rank, or 0 if the player is not on the board
+    size_t rankOf(PlayerId player) const;
+
+    // "|1.name:score(correct/total)|2...." for the whole board
+    const std::string& serialized() const;
+    // The same for the first limit entries only; costs O(limit) to rebuild
+    const std::string& serializedTop(size_t limit) const;
+    // Appends the player's own "|rank.name:score(correct/total)" entry
+    void appendPlayer(std::string& out, PlayerId player) const;
+
+private:
+    struct Key {
+        int score;
+        int correctAnswers;
+        const std::string* name;
+        PlayerId player;
+    };
+
+    struct KeyOrder {
+        bool operator()(const Key& a, const Key& b) const {
+            if (a.score != b.score) return a.score > b.score;
+            if (a.correctAnswers != b.correctAnswers) return a.correctAnswers > b.correctAnswers;
+            if (*a.name != *b.name) return *a.name < *b.name;
+            return a.player < b.player;
+        }
+    };
+
+    // Ordered tree with subtree sizes: rank queries are O(log n)
+    typedef __gnu_pbds::tree<Key, int, KeyOrder, __gnu_pbds::rb_tree_tag,
+                             __gnu_pbds::tree_order_statistics_node_update> RankTree;
+
+    std::unique_ptr<RankTree> ranking;   // mapped value: total answers
+    std::unordered_map<PlayerId, Key> entries;
+    mutable std::string cache;
+    mutable bool cacheValid;
+    mutable std::string topCache;
+    mutable size_t topCacheLimit;   // 0 when topCache is stale
+
+    void appendEntry(std::string& out, size_t rank, const Key& key, int totalAnswers) const;
+};
+
+#endif
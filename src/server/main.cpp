@@ -1,19 +1,18 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
-#include <set>
-#include "../common/protocol.h"
+#include <memory>
+#include <thread>
 #include "authentication.h"
-#include "room_manager.h"
 #include "question_manager.h"
-#include "game_engine.h"
-#include <thread>
-#include <chrono>
-#include <fstream>
-#include <ctime>
+#include "server_shard.h"
+#include "worker_pool.h"
+#include "session_directory.h"
+#include "game_snapshot.h"
+#include "password_hash.h"
 
 #include "debug_log.h"
+#include "reactor.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -23,217 +22,112 @@
 #include <netdb.h>
 #include <fcntl.h>
 #include <errno.h>
-
-struct ClientSession {
-    int socket;
-    std::string username;
-    bool authenticated;
-    int currentRoomId;
-    
-    ClientSession(int s) : socket(s), authenticated(false), currentRoomId(-1) {}
-};
-
-// Helper: send a message to a client by username
-void sendToClient(const std::string& username, const std::string& message, std::map<int, ClientSession>& clients) {
-    std::string msgWithNewline = message + "\n";
-    debugLogMsg("Sending to " + username + ": '" + message + "' (with newline)");
-    std::string rawBytes = "Raw bytes: ";
-    for (unsigned char c : msgWithNewline) {
-        char hex[4];
-        sprintf(hex, "%02X ", c);
-        rawBytes += hex;
-    }
-    debugLogMsg(rawBytes);
-    for (auto& [sock, session] : clients) {
-        if (session.username == username) {
-            send(sock, msgWithNewline.c_str(), msgWithNewline.size(), 0);
-            break;
-        }
+#include <sys/resource.h>
+
+// Raise the open-file limit so the server is not capped at the default 1024 sockets
+void raiseFileDescriptorLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
     }
 }
-// Helper: broadcast a message to all players in a room
-void broadcastToRoom(int /*roomId*/, const std::vector<std::string>& players, const std::string& message, std::map<int, ClientSession>& clients) {
-    debugLogMsg("Broadcasting to room: '" + message + "'");
-    for (const auto& username : players) {
-        sendToClient(username, message, clients);
-    }
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--reactor=epoll|select] [--threads=N] [--log-level=error|info|debug|trace]"
+              << " [--question-deadline] [--arena-capacity=N] [--questions=FILE]"
+              << " [--hash-workers=N] [--hash-cost=LOG2N] [--resume-grace=SECONDS]"
+              << " [--snapshot-interval=MS]" << std::endl;
 }
 
-// Function to process commands and return responses
-std::string processCommand(const ProtocolMessage& parsed, ClientSession& session, 
-                          AuthenticationManager& authManager, RoomManager& roomManager, GameEngine& gameEngine, std::map<int, ClientSession>& clients) {
-    std::string response;
-    
-    if (parsed.command == "REGISTER") {
-        if (parsed.params.size() >= 2) {
-            bool success = authManager.registerUser(parsed.params[0], parsed.params[1]);
-            if (success) {
-                response = buildMessage("OK", {SuccessMessages::REGISTRATION_SUCCESS});
-            } else {
-                response = buildMessage("ERROR", {ErrorMessages::USERNAME_TAKEN});
+// REGISTER/LOGIN requests allowed to wait for a hashing thread
+const size_t AUTH_QUEUE_LIMIT = 4096;
+
+int main(int argc, char* argv[]) {
+    ReactorBackend backend = ReactorBackend::EPOLL;
+    int threadCount = 1;
+    LogLevel logLevel = LogLevel::INFO;
+    bool questionDeadlines = false;
+    int arenaCapacity = GameConstants::DEFAULT_ARENA_CAPACITY;
+    std::string questionFile = "data/questions.txt";
+    int hashWorkers = static_cast<int>(std::thread::hardware_concurrency());
+    int hashCost = PasswordHashing::DEFAULT_LOG_N;
+    int resumeGrace = GameConstants::DEFAULT_RESUME_GRACE_SECONDS;
+    int snapshotInterval = GameConstants::DEFAULT_SNAPSHOT_INTERVAL_MS;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--reactor=", 0) == 0 && parseReactorBackend(arg.substr(10), backend)) {
+            continue;
+        }
+        if (arg == "--question-deadline") {
+            questionDeadlines = true;
+            continue;
+        }
+        if (arg.rfind("--questions=", 0) == 0 && arg.size() > 12) {
+            questionFile = arg.substr(12);
+            continue;
+        }
+        if (arg.rfind("--arena-capacity=", 0) == 0) {
+            arenaCapacity = std::atoi(arg.c_str() + 17);
+            if (arenaCapacity >= GameConstants::MIN_PLAYERS_TO_START) {
+                continue;
             }
-        } else {
-            response = buildMessage("ERROR", {"Invalid registration parameters"});
         }
-    } else if (parsed.command == "LOGIN") {
-        if (parsed.params.size() >= 2) {
-            bool success = authManager.authenticateUser(parsed.params[0], parsed.params[1]);
-            if (success) {
-                session.username = parsed.params[0];
-                session.authenticated = true;
-                response = buildMessage("OK", {SuccessMessages::LOGIN_SUCCESS});
-            } else {
-                response = buildMessage("ERROR", {ErrorMessages::INVALID_CREDENTIALS});
+        // 0 hashes on the event loops themselves; only useful for comparison
+        if (arg.rfind("--hash-workers=", 0) == 0) {
+            hashWorkers = std::atoi(arg.c_str() + 15);
+            if (hashWorkers >= 0) {
+                continue;
             }
-        } else {
-            response = buildMessage("ERROR", {"Invalid login parameters"});
         }
-    } else if (parsed.command == "CREATE_ROOM") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (parsed.params.size() >= 2) {
-            std::string roomName = parsed.params[1];
-            int roomId = roomManager.createRoom(roomName, session.username);
-            if (roomId > 0) {
-                session.currentRoomId = roomId;
-                response = buildMessage("OK", {SuccessMessages::ROOM_CREATED, std::to_string(roomId)});
-            } else {
-                response = buildMessage("ERROR", {"Failed to create room"});
+        if (arg.rfind("--hash-cost=", 0) == 0) {
+            hashCost = std::atoi(arg.c_str() + 12);
+            if (hashCost >= PasswordHashing::MIN_LOG_N && hashCost <= PasswordHashing::MAX_LOG_N) {
+                continue;
             }
-        } else {
-            response = buildMessage("ERROR", {"Invalid room creation parameters"});
         }
-    } else if (parsed.command == "JOIN_ROOM") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (parsed.params.size() >= 2) {
-            int roomId = std::stoi(parsed.params[1]);
-            JoinRoomResult joinResult = roomManager.joinRoom(roomId, session.username);
-            if (joinResult == JoinRoomResult::SUCCESS) {
-                session.currentRoomId = roomId;
-                response = buildMessage("OK", {SuccessMessages::ROOM_JOINED});
-            } else if (joinResult == JoinRoomResult::ROOM_NOT_FOUND) {
-                response = buildMessage("ERROR", {ErrorMessages::ROOM_NOT_FOUND});
-            } else if (joinResult == JoinRoomResult::ROOM_FULL) {
-                response = buildMessage("ERROR", {ErrorMessages::ROOM_FULL});
-            } else if (joinResult == JoinRoomResult::GAME_IN_PROGRESS) {
-                response = buildMessage("ERROR", {ErrorMessages::GAME_ALREADY_STARTED});
-            } else if (joinResult == JoinRoomResult::USER_ALREADY_IN_ROOM) {
-                response = buildMessage("ERROR", {"User is already in a room"});
-            } else if (joinResult == JoinRoomResult::USER_ALREADY_IN_THIS_ROOM) {
-                response = buildMessage("ERROR", {"User is already in this room"});
-            } else {
-                response = buildMessage("ERROR", {"Unknown join error"});
+        if (arg.rfind("--resume-grace=", 0) == 0) {
+            resumeGrace = std::atoi(arg.c_str() + 15);
+            if (resumeGrace >= 0) {
+                continue;
             }
-        } else {
-            response = buildMessage("ERROR", {"Invalid join room parameters"});
         }
-    } else if (parsed.command == "BROWSE_ROOMS") {
-        std::vector<Room> availableRooms = roomManager.getAvailableRooms();
-        std::vector<std::string> roomList;
-        for (const auto& room : availableRooms) {
-            roomList.push_back(std::to_string(room.getRoomId()));
-            roomList.push_back(room.getRoomName());
-        }
-        response = buildMessage("ROOM_LIST", roomList);
-    } else if (parsed.command == "START_GAME") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else if (parsed.params.size() >= 2) {
-            int questionCount = (parsed.params.size() >= 3) ? std::stoi(parsed.params[2]) : 10;
-            std::string result = gameEngine.startGame(session.currentRoomId, session.username, questionCount);
-            response = buildMessage("GAME_RESPONSE", {result});
-            // Send first question to all players
-            auto players = roomManager.getRoomPlayers(session.currentRoomId);
-            std::string playersList = "START_GAME: Sending first question to players: ";
-            for (const auto& player : players) playersList += player + " ";
-            debugLogMsg(playersList);
-            for (const auto& player : players) {
-                std::string qmsg = gameEngine.getCurrentQuestion(session.currentRoomId, player);
-                std::string fullMsg = buildMessage("GAME_RESPONSE", {qmsg});
-                debugLogMsg("To player '" + player + "': '" + fullMsg + "'");
-                sendToClient(player, fullMsg, clients);
-                std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Small delay
+        // 0 turns game snapshots off, and with them restoring games at startup
+        if (arg.rfind("--snapshot-interval=", 0) == 0) {
+            snapshotInterval = std::atoi(arg.c_str() + 20);
+            if (snapshotInterval >= 0) {
+                continue;
             }
-        } else {
-            response = buildMessage("ERROR", {"Invalid start game parameters"});
-        }
-    } else if (parsed.command == "END_GAME") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else {
-            std::string result = gameEngine.endGame(session.currentRoomId, session.username);
-            response = buildMessage("GAME_RESPONSE", {result});
-        }
-    } else if (parsed.command == "GET_CURRENT_QUESTION") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else {
-            std::string result = gameEngine.getCurrentQuestion(session.currentRoomId, session.username);
-            response = buildMessage("GAME_RESPONSE", {result});
         }
-    } else if (parsed.command == "SUBMIT_ANSWER") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else if (parsed.params.size() >= 3) {
-            int answerIndex = std::stoi(parsed.params[2]);
-            std::string result = gameEngine.submitAnswer(session.currentRoomId, session.username, answerIndex);
-            response = buildMessage("GAME_RESPONSE", {result});
-            debugLogMsg("SUBMIT_ANSWER: Sent feedback to " + session.username + ": '" + response + "'");
-            // Do NOT send the next question here. Client must request it after processing feedback.
-        } else {
-            response = buildMessage("ERROR", {"Invalid submit answer parameters"});
+        if (arg.rfind("--log-level=", 0) == 0 && parseLogLevel(arg.substr(12), logLevel)) {
+            continue;
         }
-    } else if (parsed.command == "GET_GAME_INFO") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else {
-            std::string result = gameEngine.getGameInfo(session.currentRoomId, session.username);
-            response = buildMessage("GAME_RESPONSE", {result});
-        }
-    } else if (parsed.command == "GET_LEADERBOARD") {
-        if (!session.authenticated) {
-            response = buildMessage("ERROR", {"Not authenticated"});
-        } else if (session.currentRoomId == -1) {
-            response = buildMessage("ERROR", {"Not in a room"});
-        } else {
-            std::string result = gameEngine.getLeaderboard(session.currentRoomId, session.username);
-            response = buildMessage("GAME_RESPONSE", {result});
+        if (arg.rfind("--threads=", 0) == 0) {
+            threadCount = std::atoi(arg.c_str() + 10);
+            if (threadCount == 0) {
+                threadCount = static_cast<int>(std::thread::hardware_concurrency());
+            }
+            if (threadCount >= 1) {
+                continue;
+            }
         }
-    } else if (parsed.command == "QUIT") {
-        response = buildMessage("OK", {"Goodbye"});
-    } else {
-        response = buildMessage("ERROR", {"Unknown command"});
+        printUsage(argv[0]);
+        return 1;
     }
-    
-    return response;
-}
 
-int main() {
     // Initialize debug logging
+    setDebugLogLevel(logLevel);
     initDebugLog();
+    raiseFileDescriptorLimit();
     
     int listenSocket = -1;
     const int PORT = 8080;
-    char buffer[1024];
     
-    AuthenticationManager authManager;
-    RoomManager roomManager;
-    QuestionManager questionManager;
-    GameEngine gameEngine(roomManager, questionManager);
-
-    std::map<int, ClientSession> clients;
-    fd_set master, read_fds;
+    AuthenticationManager authManager("data/users.txt", hashCost);
+    WorkerPool authWorkers(static_cast<size_t>(hashWorkers), AUTH_QUEUE_LIMIT);
+    SessionDirectory sessionDirectory;
+    QuestionManager questionManager(questionFile);
+    GameSnapshotStore snapshotStore("data/games.snapshot");
 
     listenSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (listenSocket == -1) {
@@ -261,101 +155,85 @@ int main() {
     }
     std::cout << "Server listening on port " << PORT << "..." << std::endl;
 
-    FD_ZERO(&master);
-    FD_ZERO(&read_fds);
-    FD_SET(listenSocket, &master);
-
-    std::cout << "Server ready for multiple clients..." << std::endl;
-    
-    while (true) {
-        read_fds = master;
-        
-        int maxfd = listenSocket;
-        for (const auto& c : clients) if (c.first > maxfd) maxfd = c.first;
-        int activity = select(maxfd + 1, &read_fds, NULL, NULL, NULL);
-        if (activity == -1) {
-            std::cerr << "Select failed with error: " << errno << std::endl;
-            break;
-        }
+    std::vector<std::unique_ptr<ServerShard>> shards;
+    std::vector<ServerShard*> peers;
+    for (int i = 0; i < threadCount; ++i) {
+        shards.push_back(std::make_unique<ServerShard>(i, threadCount, backend, authManager, questionManager, authWorkers, sessionDirectory));
+        if (!shards.back()->init()) {
+            std::cerr << "Failed to initialize shard " << i << "." << std::endl;
+            close(listenSocket);
+            return 1;
+        }
+        if (questionDeadlines) {
+            shards.back()->enableQuestionDeadlines();
+        }
+        shards.back()->setArenaCapacity(arenaCapacity);
+        shards.back()->setResumeGrace(resumeGrace);
+        peers.push_back(shards.back().get());
+    }
+    for (auto& shard : shards) {
+        shard->setPeers(peers);
+    }
 
-        if (FD_ISSET(listenSocket, &read_fds)) {
-            int clientSocket = accept(listenSocket, NULL, NULL);
-            if (clientSocket != -1) {
-                int clientFlags = fcntl(clientSocket, F_GETFL, 0);
-                fcntl(clientSocket, F_SETFL, clientFlags | O_NONBLOCK);
-                
-                FD_SET(clientSocket, &master);
-                
-                clients.emplace(clientSocket, ClientSession(clientSocket));
-                
-                std::cout << "Client connected. Socket: " << clientSocket << " Total clients: " << clients.size() << std::endl;
+    // Bring back the games that were running when the server last stopped
+    if (snapshotInterval > 0) {
+        for (auto& shard : shards) {
+            shard->enableSnapshots(snapshotStore, snapshotInterval);
+        }
+        std::vector<std::pair<int, std::string>> savedRooms;
+        std::vector<std::string> savedSessions;
+        if (snapshotStore.load(savedRooms, savedSessions)) {
+            size_t restored = 0;
+            for (const auto& [roomId, record] : savedRooms) {
+                restored += shards[shards[0]->ownerOf(roomId)]->restoreRoom(roomId, record);
             }
-        }
-
-        std::vector<int> toRemove;
-        
-        for (auto it = clients.begin(); it != clients.end(); ++it) {
-            int clientSocket = it->first;
-            ClientSession& session = it->second;
-            
-            if (FD_ISSET(clientSocket, &read_fds)) {
-                int recvLen = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-                
-                if (recvLen > 0) {
-                    buffer[recvLen] = '\0';
-                    std::string msg(buffer);
-                    
-                    if (!msg.empty() && msg.back() == '\n') {
-                        msg.pop_back();
-                    }
-                    
-                    ProtocolMessage parsed = parseMessage(msg);
-                    debugLogMsg("Received from client " + std::to_string(clientSocket) + " (" + session.username + "): '" + msg + "' Parsed command: '" + parsed.command + "'");
-                    
-                    std::string response = processCommand(parsed, session, authManager, roomManager, gameEngine, clients);
-                    
-                    if (response.empty() || response.back() != '\n') response += '\n';
-                    int sendResult = send(clientSocket, response.c_str(), static_cast<int>(response.size()), 0);
-                    if (sendResult == -1) {
-                        std::cerr << "Send failed for client " << clientSocket << std::endl;
-                        toRemove.push_back(clientSocket);
-                    }
-                    
-                } else if (recvLen == 0) {
-                    std::cout << "Client " << clientSocket << " (" << session.username << ") disconnected." << std::endl;
-                    toRemove.push_back(clientSocket);
-                } else {
-                    if (errno != EWOULDBLOCK && errno != EAGAIN) {
-                        std::cerr << "Receive error for client " << clientSocket << ": " << errno << std::endl;
-                        toRemove.push_back(clientSocket);
-                    }
+            for (auto& shard : shards) {
+                for (const std::string& record : savedSessions) {
+                    shard->restoreSessions(record);
                 }
             }
-        }
-
-        // Remove disconnected clients
-        for (int clientSocket : toRemove) {
-            auto it = clients.find(clientSocket);
-            if (it != clients.end()) {
-                ClientSession& session = it->second;
-                if (session.currentRoomId != -1) {
-                    gameEngine.removePlayer(session.currentRoomId, session.username);
-                }
+            std::cout << "Restored " << restored << " of " << savedRooms.size() << " room(s) from the game snapshot." << std::endl;
+            // Encode every restored room now rather than in time slices over the
+            // first ticks, so the first file written already holds all of them
+            for (auto& shard : shards) {
+                shard->saveSnapshot();
             }
-            
-            FD_CLR(clientSocket, &master);
-            close(clientSocket);
-            clients.erase(clientSocket);
-            
-            std::cout << "Client " << clientSocket << " removed. Total clients: " << clients.size() << std::endl;
         }
+        snapshotStore.start();
     }
 
-    for (auto& pair : clients) {
-        close(pair.first);
+    // Shard 0 owns the listener and deals new connections out to every shard
+    if (!shards[0]->setListener(listenSocket)) {
+        std::cerr << "Could not watch listening socket." << std::endl;
+        close(listenSocket);
+        return 1;
+    }
+
+    std::cout << "Server ready for multiple clients (" << threadCount << " shard(s))..." << std::endl;
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threadCount; ++i) {
+        ServerShard* shard = shards[i].get();
+        workers.emplace_back([shard]() { shard->run(); });
+    }
+    shards[0]->run();
+
+    for (int i = 1; i < threadCount; ++i) {
+        shards[i]->stop();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // Hashing jobs and durability callbacks post to the shards, so both stop first
+    authWorkers.stop();
+    authManager.closeUserLog();
+    for (auto& shard : shards) {
+        shard->saveSnapshot();
     }
+    snapshotStore.stop();
+    shards.clear();
     close(listenSocket);
     closeDebugLog();
     std::cout << "Server shut down." << std::endl;
     return 0;
-} 
\ No newline at end of file
+} 
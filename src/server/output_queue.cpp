@@ -0,0 +1,91 @@
+#include "output_queue.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+namespace {
+    const size_t COALESCE_LIMIT = 16 * 1024;   // small frames share a chunk up to this size
+    const int MAX_IOV = 64;
+}
+
+OutputQueue::OutputQueue() : headOffset(0), pendingBytes(0), appendMark(0) {
+}
+
+void OutputQueue::append(std::string_view bytes) {
+    if (bytes.empty()) {
+        return;
+    }
+    if (chunks.empty() || chunks.back().shared || chunks.back().size() + bytes.size() > COALESCE_LIMIT) {
+        chunks.emplace_back();
+    }
+    chunks.back().owned.append(bytes.data(), bytes.size());
+    pendingBytes += bytes.size();
+}
+
+void OutputQueue::appendShared(std::shared_ptr<const std::string> bytes) {
+    if (!bytes || bytes->empty()) {
+        return;
+    }
+    pendingBytes += bytes->size();
+    chunks.emplace_back();
+    chunks.back().shared = std::move(bytes);
+}
+
+std::string& OutputQueue::beginAppend() {
+    if (chunks.empty() || chunks.back().shared || chunks.back().size() >= COALESCE_LIMIT) {
+        chunks.emplace_back();
+    }
+    appendMark = chunks.back().owned.size();
+    return chunks.back().owned;
+}
+
+size_t OutputQueue::endAppend() {
+    size_t added = chunks.back().owned.size() - appendMark;
+    pendingBytes += added;
+    return added;
+}
+
+OutputQueue::FlushResult OutputQueue::flush(int socket, OutputStats& stats) {
+    while (pendingBytes > 0) {
+        iovec iov[MAX_IOV];
+        int count = 0;
+        for (auto it = chunks.begin(); it != chunks.end() && count < MAX_IOV; ++it, ++count) {
+            size_t offset = (count == 0) ? headOffset : 0;
+            iov[count].iov_base = const_cast<char*>(it->data() + offset);
+            iov[count].iov_len = it->size() - offset;
+        }
+
+        msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t sent = sendmsg(socket, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EWOULDBLOCK || errno == EAGAIN) ? FlushResult::PENDING : FlushResult::ERROR;
+        }
+
+        size_t remaining = static_cast<size_t>(sent);
+        pendingBytes -= remaining;
+        stats.bytesSent += remaining;
+        while (remaining > 0) {
+            size_t headLeft = chunks.front().size() - headOffset;
+            if (remaining < headLeft) {
+                headOffset += remaining;
+                break;
+            }
+            remaining -= headLeft;
+            chunks.pop_front();
+            headOffset = 0;
+        }
+    }
+    return FlushResult::DRAINED;
+}
+
+size_t OutputQueue::clear() {
+    size_t dropped = pendingBytes;
+    chunks.clear();
+    headOffset = 0;
+    pendingBytes = 0;
+    return dropped;
+}
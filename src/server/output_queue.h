@@ -0,0 +1,63 @@
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// Byte counters kept per shard for all of its sessions
+struct OutputStats {
+    uint64_t bytesQueued = 0;
+    uint64_t bytesSent = 0;
+    uint64_t bytesDropped = 0;
+    uint64_t slowConsumersDropped = 0;
+};
+
+// Per-connection outbound queue. Frames are appended without blocking and
+// written with scatter/gather sends whenever the socket is writable; short
+// writes leave the remainder queued for the next flush.
+class OutputQueue {
+public:
+    enum class FlushResult {
+        DRAINED,
+        PENDING,   // socket buffer is full; wait for writability
+        ERROR
+    };
+
+    OutputQueue();
+
+    void append(std::string_view bytes);
+    // Queues a frame shared with other sessions without copying it
+    void appendShared(std::shared_ptr<const std::string> bytes);
+
+    // In-place building: append to the returned buffer, then call endAppend(),
+    // which returns the number of bytes added
+    std::string& beginAppend();
+    size_t endAppend();
+    FlushResult flush(int socket, OutputStats& stats);
+
+    // Discards everything still queued and returns the number of bytes dropped
+    size_t clear();
+
+    bool empty() const { return pendingBytes == 0; }
+    size_t size() const { return pendingBytes; }
+
+private:
+    struct Chunk {
+        std::string owned;
+        std::shared_ptr<const std::string> shared;
+
+        const char* data() const { return shared ? shared->data() : owned.data(); }
+        size_t size() const { return shared ? shared->size() : owned.size(); }
+    };
+
+    std::deque<Chunk> chunks;
+    size_t headOffset;     // bytes of chunks.front() already sent
+    size_t pendingBytes;
+    size_t appendMark;     // tail size at beginAppend()
+};
+
+#endif
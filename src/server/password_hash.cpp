@@ -0,0 +1,360 @@
+#include "password_hash.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <cerrno>
+
+#include <sys/random.h>
+
+namespace {
+    const uint32_t SHA256_K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    inline uint32_t rotr(uint32_t value, int bits) {
+        return (value >> bits) | (value << (32 - bits));
+    }
+
+    inline uint32_t rotl(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    inline uint32_t loadBigEndian(const uint8_t* bytes) {
+        return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+    }
+
+    inline void storeBigEndian(uint8_t* bytes, uint32_t value) {
+        bytes[0] = uint8_t(value >> 24);
+        bytes[1] = uint8_t(value >> 16);
+        bytes[2] = uint8_t(value >> 8);
+        bytes[3] = uint8_t(value);
+    }
+
+    inline uint32_t loadLittleEndian(const uint8_t* bytes) {
+        return uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8) | (uint32_t(bytes[2]) << 16) | (uint32_t(bytes[3]) << 24);
+    }
+
+    inline void storeLittleEndian(uint8_t* bytes, uint32_t value) {
+        bytes[0] = uint8_t(value);
+        bytes[1] = uint8_t(value >> 8);
+        bytes[2] = uint8_t(value >> 16);
+        bytes[3] = uint8_t(value >> 24);
+    }
+
+    // FIPS 180-4 SHA-256
+    class Sha256 {
+    public:
+        Sha256() : totalBytes(0), bufferLength(0) {
+            static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                                0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+            std::memcpy(state, initial, sizeof(state));
+        }
+
+        void update(const uint8_t* data, size_t length) {
+            totalBytes += length;
+            if (bufferLength > 0) {
+                size_t take = std::min(length, sizeof(buffer) - bufferLength);
+                std::memcpy(buffer + bufferLength, data, take);
+                bufferLength += take;
+                data += take;
+                length -= take;
+                if (bufferLength < sizeof(buffer)) {
+                    return;
+                }
+                transform(buffer);
+                bufferLength = 0;
+            }
+            for (; length >= sizeof(buffer); data += sizeof(buffer), length -= sizeof(buffer)) {
+                transform(data);
+            }
+            std::memcpy(buffer, data, length);
+            bufferLength = length;
+        }
+
+        void finish(uint8_t digest[32]) {
+            uint64_t bitLength = totalBytes * 8;
+            uint8_t padding[72] = {0x80};
+            size_t padLength = (bufferLength < 56) ? (56 - bufferLength) : (120 - bufferLength);
+            for (int i = 0; i < 8; ++i) {
+                padding[padLength + i] = uint8_t(bitLength >> (56 - 8 * i));
+            }
+            update(padding, padLength + 8);
+            for (int i = 0; i < 8; ++i) {
+                storeBigEndian(digest + 4 * i, state[i]);
+            }
+        }
+
+    private:
+        uint32_t state[8];
+        uint8_t buffer[64];
+        uint64_t totalBytes;
+        size_t bufferLength;
+
+        void transform(const uint8_t* block) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = loadBigEndian(block + 4 * i);
+            }
+            for (int i = 16; i < 64; ++i) {
+                uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i) {
+                uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+                uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+    };
+
+    // HMAC-SHA256 with the keyed inner and outer states kept for reuse
+    class HmacSha256 {
+    public:
+        explicit HmacSha256(const std::string& key) {
+            uint8_t block[64] = {};
+            if (key.size() > sizeof(block)) {
+                Sha256 keyHash;
+                keyHash.update(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+                keyHash.finish(block);
+            } else {
+                std::memcpy(block, key.data(), key.size());
+            }
+            uint8_t pad[64];
+            for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x36;
+            inner.update(pad, sizeof(pad));
+            for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = block[i] ^ 0x5c;
+            outer.update(pad, sizeof(pad));
+        }
+
+        Sha256 inner;
+        Sha256 outer;
+
+        void finish(Sha256& message, uint8_t mac[32]) const {
+            uint8_t innerDigest[32];
+            message.finish(innerDigest);
+            Sha256 result = outer;
+            result.update(innerDigest, sizeof(innerDigest));
+            result.finish(mac);
+        }
+    };
+
+    // PBKDF2-HMAC-SHA256 with one iteration, which is all scrypt uses
+    void pbkdf2Sha256(const HmacSha256& hmac, const uint8_t* salt, size_t saltLength, uint8_t* out, size_t length) {
+        for (uint32_t blockIndex = 1; length > 0; ++blockIndex) {
+            uint8_t counter[4];
+            storeBigEndian(counter, blockIndex);
+            Sha256 message = hmac.inner;
+            message.update(salt, saltLength);
+            message.update(counter, sizeof(counter));
+            uint8_t block[32];
+            hmac.finish(message, block);
+            size_t take = std::min(length, sizeof(block));
+            std::memcpy(out, block, take);
+            out += take;
+            length -= take;
+        }
+    }
+
+    void salsa20_8(uint32_t block[16]) {
+        uint32_t x[16];
+        std::memcpy(x, block, sizeof(x));
+        for (int round = 0; round < 8; round += 2) {
+            x[ 4] ^= rotl(x[ 0] + x[12],  7);  x[ 8] ^= rotl(x[ 4] + x[ 0],  9);
+            x[12] ^= rotl(x[ 8] + x[ 4], 13);  x[ 0] ^= rotl(x[12] + x[ 8], 18);
+            x[ 9] ^= rotl(x[ 5] + x[ 1],  7);  x[13] ^= rotl(x[ 9] + x[ 5],  9);
+            x[ 1] ^= rotl(x[13] + x[ 9], 13);  x[ 5] ^= rotl(x[ 1] + x[13], 18);
+            x[14] ^= rotl(x[10] + x[ 6],  7);  x[ 2] ^= rotl(x[14] + x[10],  9);
+            x[ 6] ^= rotl(x[ 2] + x[14], 13);  x[10] ^= rotl(x[ 6] + x[ 2], 18);
+            x[ 3] ^= rotl(x[15] + x[11],  7);  x[ 7] ^= rotl(x[ 3] + x[15],  9);
+            x[11] ^= rotl(x[ 7] + x[ 3], 13);  x[15] ^= rotl(x[11] + x[ 7], 18);
+            x[ 1] ^= rotl(x[ 0] + x[ 3],  7);  x[ 2] ^= rotl(x[ 1] + x[ 0],  9);
+            x[ 3] ^= rotl(x[ 2] + x[ 1], 13);  x[ 0] ^= rotl(x[ 3] + x[ 2], 18);
+            x[ 6] ^= rotl(x[ 5] + x[ 4],  7);  x[ 7] ^= rotl(x[ 6] + x[ 5],  9);
+            x[ 4] ^= rotl(x[ 7] + x[ 6], 13);  x[ 5] ^= rotl(x[ 4] + x[ 7], 18);
+            x[11] ^= rotl(x[10] + x[ 9],  7);  x[ 8] ^= rotl(x[11] + x[10],  9);
+            x[ 9] ^= rotl(x[ 8] + x[11], 13);  x[10] ^= rotl(x[ 9] + x[ 8], 18);
+            x[12] ^= rotl(x[15] + x[14],  7);  x[13] ^= rotl(x[12] + x[15],  9);
+            x[14] ^= rotl(x[13] + x[12], 13);  x[15] ^= rotl(x[14] + x[13], 18);
+        }
+        for (int i = 0; i < 16; ++i) {
+            block[i] += x[i];
+        }
+    }
+
+    // scryptBlockMix: in and out are 2r 64-byte blocks
+    void blockMix(const uint32_t* in, uint32_t* out, uint32_t r) {
+        uint32_t x[16];
+        std::memcpy(x, in + (2 * r - 1) * 16, sizeof(x));
+        for (uint32_t i = 0; i < 2 * r; ++i) {
+            for (int k = 0; k < 16; ++k) {
+                x[k] ^= in[i * 16 + k];
+            }
+            salsa20_8(x);
+            // Even blocks go to the first half of the output, odd ones to the second
+            std::memcpy(out + ((i / 2) + (i % 2) * r) * 16, x, sizeof(x));
+        }
+    }
+
+    // scryptROMix over one 128r-byte block; v holds N blocks
+    void roMix(uint8_t* bytes, uint64_t N, uint32_t r, std::vector<uint32_t>& v) {
+        size_t words = 32 * r;
+        std::vector<uint32_t> x(words), y(words);
+        for (size_t i = 0; i < words; ++i) {
+            x[i] = loadLittleEndian(bytes + 4 * i);
+        }
+        for (uint64_t i = 0; i < N; ++i) {
+            std::memcpy(&v[i * words], x.data(), words * sizeof(uint32_t));
+            blockMix(x.data(), y.data(), r);
+            x.swap(y);
+        }
+        for (uint64_t i = 0; i < N; ++i) {
+            const uint32_t* last = &x[(2 * r - 1) * 16];
+            uint64_t j = ((uint64_t(last[1]) << 32) | last[0]) & (N - 1);
+            const uint32_t* source = &v[j * words];
+            for (size_t k = 0; k < words; ++k) {
+                x[k] ^= source[k];
+            }
+            blockMix(x.data(), y.data(), r);
+            x.swap(y);
+        }
+        for (size_t i = 0; i < words; ++i) {
+            storeLittleEndian(bytes + 4 * i, x[i]);
+        }
+    }
+
+    void randomBytes(uint8_t* out, size_t length) {
+        while (length > 0) {
+            ssize_t got = getrandom(out, length, 0);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                std::random_device device;
+                for (; length > 0; --length) *out++ = static_cast<uint8_t>(device());
+                return;
+            }
+            out += got;
+            length -= static_cast<size_t>(got);
+        }
+    }
+
+    std::string toHex(const uint8_t* bytes, size_t length) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(length * 2, '0');
+        for (size_t i = 0; i < length; ++i) {
+            hex[2 * i] = digits[bytes[i] >> 4];
+            hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+        }
+        return hex;
+    }
+
+    bool fromHex(const std::string& hex, std::string& bytes) {
+        if (hex.size() % 2 != 0) {
+            return false;
+        }
+        bytes.assign(hex.size() / 2, '\0');
+        for (size_t i = 0; i < hex.size(); ++i) {
+            char c = hex[i];
+            int value = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+            if (value < 0) {
+                return false;
+            }
+            bytes[i / 2] = static_cast<char>((static_cast<uint8_t>(bytes[i / 2]) << 4) | value);
+        }
+        return true;
+    }
+
+    bool parseField(const std::string& text, size_t& position, std::string& field) {
+        size_t end = text.find('$', position);
+        field = text.substr(position, end == std::string::npos ? std::string::npos : end - position);
+        position = (end == std::string::npos) ? text.size() : end + 1;
+        return !field.empty();
+    }
+
+    bool parseSmallInt(const std::string& field, uint32_t limit, uint32_t& value) {
+        if (field.empty() || field.size() > 4 || field.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        value = static_cast<uint32_t>(std::stoul(field));
+        return value >= 1 && value <= limit;
+    }
+
+    // Compares without an early exit so timing does not reveal the matching prefix
+    bool constantTimeEquals(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        uint8_t difference = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            difference |= static_cast<uint8_t>(a[i] ^ b[i]);
+        }
+        return difference == 0;
+    }
+
+    const std::string HASH_PREFIX = "$scrypt$";
+}
+
+void scrypt(const std::string& password, const std::string& salt, uint64_t N, uint32_t r, uint32_t p,
+            uint8_t* out, size_t length) {
+    HmacSha256 hmac(password);
+    size_t blockBytes = 128 * static_cast<size_t>(r);
+    std::vector<uint8_t> blocks(blockBytes * p);
+    pbkdf2Sha256(hmac, reinterpret_cast<const uint8_t*>(salt.data()), salt.size(), blocks.data(), blocks.size());
+    std::vector<uint32_t> v(static_cast<size_t>(N) * 32 * r);
+    for (uint32_t i = 0; i < p; ++i) {
+        roMix(blocks.data() + i * blockBytes, N, r, v);
+    }
+    pbkdf2Sha256(hmac, blocks.data(), blocks.size(), out, length);
+}
+
+std::string hashPassword(const std::string& password, int logN) {
+    uint8_t salt[PasswordHashing::SALT_BYTES];
+    randomBytes(salt, sizeof(salt));
+    uint8_t hash[PasswordHashing::HASH_BYTES];
+    scrypt(password, std::string(reinterpret_cast<const char*>(salt), sizeof(salt)), uint64_t(1) << logN,
+           PasswordHashing::BLOCK_SIZE_R, PasswordHashing::PARALLELISM_P, hash, sizeof(hash));
+    return HASH_PREFIX + std::to_string(logN) + "$" + std::to_string(PasswordHashing::BLOCK_SIZE_R) + "$"
+           + std::to_string(PasswordHashing::PARALLELISM_P) + "$" + toHex(salt, sizeof(salt)) + "$"
+           + toHex(hash, sizeof(hash));
+}
+
+bool verifyPassword(const std::string& password, const std::string& stored, int& storedLogN) {
+    storedLogN = 0;
+    if (stored.compare(0, HASH_PREFIX.size(), HASH_PREFIX) != 0) {
+        return constantTimeEquals(password, stored);
+    }
+    // Bounds keep a damaged or hostile users.txt from demanding huge amounts of memory
+    size_t position = HASH_PREFIX.size();
+    std::string logNField, rField, pField, saltHex, hashHex, salt, expected;
+    uint32_t logN, r, p;
+    if (!parseField(stored, position, logNField) || !parseSmallInt(logNField, PasswordHashing::MAX_LOG_N, logN)
+        || !parseField(stored, position, rField) || !parseSmallInt(rField, 32, r)
+        || !parseField(stored, position, pField) || !parseSmallInt(pField, 16, p)
+        || !parseField(stored, position, saltHex) || !fromHex(saltHex, salt)
+        || !parseField(stored, position, hashHex) || !fromHex(hashHex, expected)
+        || position != stored.size() || expected.empty() || expected.size() > 64) {
+        return false;
+    }
+    std::string actual(expected.size(), '\0');
+    scrypt(password, salt, uint64_t(1) << logN, r, p, reinterpret_cast<uint8_t*>(&actual[0]), actual.size());
+    storedLogN = static_cast<int>(logN);
+    return constantTimeEquals(actual, expected);
+}
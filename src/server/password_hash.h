@@ -0,0 +1,34 @@
+#ifndef PASSWORD_HASH_H
+#define PASSWORD_HASH_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Salted scrypt password hashes (RFC 7914). Stored hashes look like
+//   $scrypt$<log2 N>$<r>$<p>$<salt hex>$<hash hex>
+// and contain no whitespace, so they fit the users.txt record format.
+// Hashing with the default cost takes tens of milliseconds and 16 MiB of
+// memory, so it must never run on a shard's event loop.
+namespace PasswordHashing {
+    const int DEFAULT_LOG_N = 14;   // N = 16384
+    const int MIN_LOG_N = 10;
+    const int MAX_LOG_N = 20;
+    const uint32_t BLOCK_SIZE_R = 8;
+    const uint32_t PARALLELISM_P = 1;
+    const size_t SALT_BYTES = 16;
+    const size_t HASH_BYTES = 32;
+}
+
+// Derives length bytes from password and salt; N must be a power of two
+void scrypt(const std::string& password, const std::string& salt, uint64_t N, uint32_t r, uint32_t p,
+            uint8_t* out, size_t length);
+
+// Hashes password with a fresh random salt and N = 2^logN
+std::string hashPassword(const std::string& password, int logN);
+
+// Checks password against a stored value. Stored values that are not
+// scrypt hashes are legacy plaintext passwords; for those storedLogN is 0.
+bool verifyPassword(const std::string& password, const std::string& stored, int& storedLogN);
+
+#endif
@@ -0,0 +1,68 @@
+#include "player_directory.h"
+
+PlayerDirectory::PlayerDirectory()
+    : chunks(new std::atomic<std::string*>[MAX_CHUNKS]), count(0) {
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PlayerDirectory::~PlayerDirectory() {
+    for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+        delete[] chunks[i].load(std::memory_order_relaxed);
+    }
+}
+
+PlayerId PlayerDirectory::intern(const std::string& username) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(username);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    size_t id = count.load(std::memory_order_relaxed);
+    if (id >= MAX_CHUNKS * CHUNK_SIZE) {
+        return INVALID_PLAYER_ID;
+    }
+    std::string* chunk = chunks[id >> CHUNK_BITS].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new std::string[CHUNK_SIZE];
+        chunks[id >> CHUNK_BITS].store(chunk, std::memory_order_release);
+    }
+    chunk[id & (CHUNK_SIZE - 1)] = username;
+    count.store(id + 1, std::memory_order_release);
+    ids.emplace(username, static_cast<PlayerId>(id));
+    return static_cast<PlayerId>(id);
+}
+
+PlayerId PlayerDirectory::find(const std::string& username) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(username);
+    return it != ids.end() ? it->second : INVALID_PLAYER_ID;
+}
+
+const std::string& PlayerDirectory::nameOf(PlayerId id) const {
+    static const std::string unknown;
+    if (id >= count.load(std::memory_order_acquire)) {
+        return unknown;
+    }
+    return chunks[id >> CHUNK_BITS].load(std::memory_order_acquire)[id & (CHUNK_SIZE - 1)];
+}
+
+bool PlayerDirectory::claimRoom(PlayerId player, int roomId) {
+    std::lock_guard<std::mutex> lock(roomMutex);
+    return roomOfPlayer.emplace(player, roomId).second;
+}
+
+void PlayerDirectory::releaseRoom(PlayerId player, int roomId) {
+    std::lock_guard<std::mutex> lock(roomMutex);
+    auto it = roomOfPlayer.find(player);
+    if (it != roomOfPlayer.end() && it->second == roomId) {
+        roomOfPlayer.erase(it);
+    }
+}
+
+int PlayerDirectory::roomOf(PlayerId player) const {
+    std::lock_guard<std::mutex> lock(roomMutex);
+    auto it = roomOfPlayer.find(player);
+    return it != roomOfPlayer.end() ? it->second : -1;
+}
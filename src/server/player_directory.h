@@ -0,0 +1,53 @@
+#ifndef PLAYER_DIRECTORY_H
+#define PLAYER_DIRECTORY_H
+
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include "../common/player_id.h"
+
+// Interns usernames to PlayerIds. Interning takes a lock; resolving an id
+// back to its name does not, so shards can render leaderboards without
+// contending with logins on other threads.
+//
+// Also records the room each player is in. Rooms live on different shards
+// and a player may be connected to several, so this is the one place that
+// keeps a player in at most one room.
+class PlayerDirectory {
+public:
+    PlayerDirectory();
+    ~PlayerDirectory();
+
+    PlayerId intern(const std::string& username);
+    PlayerId find(const std::string& username) const;
+
+    // The reference stays valid for the directory's lifetime
+    const std::string& nameOf(PlayerId id) const;
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+
+    // Puts the player in roomId; false if they are already in a room
+    bool claimRoom(PlayerId player, int roomId);
+    // Takes the player out of roomId; does nothing if they are in another room
+    void releaseRoom(PlayerId player, int roomId);
+    // The player's room, or -1
+    int roomOf(PlayerId player) const;
+
+private:
+    static const size_t CHUNK_BITS = 12;
+    static const size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static const size_t MAX_CHUNKS = 16384;   // 64M players
+
+    // Names live in fixed-size chunks that never move once published
+    std::unique_ptr<std::atomic<std::string*>[]> chunks;
+    std::atomic<size_t> count;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, PlayerId> ids;
+
+    mutable std::mutex roomMutex;
+    std::unordered_map<PlayerId, int> roomOfPlayer;
+};
+
+#endif
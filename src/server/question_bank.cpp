@@ -0,0 +1,212 @@
+#include "question_bank.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    uint64_t alignUp(uint64_t offset) {
+        return (offset + 7) & ~static_cast<uint64_t>(7);
+    }
+
+    void writePadding(std::ofstream& file, uint64_t from, uint64_t to) {
+        static const char zeros[8] = {};
+        file.write(zeros, static_cast<std::streamsize>(to - from));
+    }
+}
+
+bool writeQuestionBank(const std::string& path, const std::vector<QuestionSource>& questions, std::string& error) {
+    if (questions.size() > UINT32_MAX) {
+        error = "too many questions";
+        return false;
+    }
+    std::vector<QuestionRecord> records(questions.size());
+    std::vector<QuestionIndexEntry> index(questions.size());
+    std::string strings;
+    for (size_t i = 0; i < questions.size(); ++i) {
+        const QuestionSource& source = questions[i];
+        std::string name = "question " + std::to_string(source.questionId);
+        if (source.options.size() > QuestionBankFormat::MAX_OPTIONS) {
+            error = name + " has more than " + std::to_string(QuestionBankFormat::MAX_OPTIONS) + " options";
+            return false;
+        }
+        if (source.correctAnswerIndex < 0 || source.correctAnswerIndex >= static_cast<int>(source.options.size())) {
+            error = name + " has no option " + std::to_string(source.correctAnswerIndex);
+            return false;
+        }
+        QuestionRecord& record = records[i];
+        std::memset(&record, 0, sizeof(record));
+        record.questionId = source.questionId;
+        record.stringsOffset = static_cast<uint32_t>(strings.size());
+        record.optionCount = static_cast<uint8_t>(source.options.size());
+        record.correctAnswerIndex = static_cast<int8_t>(source.correctAnswerIndex);
+        bool fits = source.questionText.size() <= QuestionBankFormat::MAX_STRING_LENGTH;
+        record.textLength = static_cast<uint16_t>(source.questionText.size());
+        strings += source.questionText;
+        for (size_t option = 0; option < source.options.size(); ++option) {
+            fits = fits && source.options[option].size() <= QuestionBankFormat::MAX_STRING_LENGTH;
+            record.optionLengths[option] = static_cast<uint16_t>(source.options[option].size());
+            strings += source.options[option];
+        }
+        if (!fits) {
+            error = name + " has a string longer than " + std::to_string(QuestionBankFormat::MAX_STRING_LENGTH) + " bytes";
+            return false;
+        }
+        if (strings.size() > UINT32_MAX) {
+            error = "string table exceeds 4 GiB";
+            return false;
+        }
+        index[i].questionId = source.questionId;
+        index[i].position = static_cast<uint32_t>(i);
+    }
+    std::sort(index.begin(), index.end(), [](const QuestionIndexEntry& a, const QuestionIndexEntry& b) {
+        return a.questionId < b.questionId;
+    });
+    for (size_t i = 1; i < index.size(); ++i) {
+        if (index[i].questionId == index[i - 1].questionId) {
+            error = "duplicate question id " + std::to_string(index[i].questionId);
+            return false;
+        }
+    }
+
+    QuestionBankHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, QuestionBankFormat::MAGIC, sizeof(header.magic));
+    header.version = QuestionBankFormat::VERSION;
+    header.questionCount = static_cast<uint32_t>(questions.size());
+    header.recordsOffset = alignUp(sizeof(header));
+    header.indexOffset = alignUp(header.recordsOffset + records.size() * sizeof(QuestionRecord));
+    header.stringsOffset = alignUp(header.indexOffset + index.size() * sizeof(QuestionIndexEntry));
+    header.stringsSize = strings.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        error = "cannot open " + path + " for writing";
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writePadding(file, sizeof(header), header.recordsOffset);
+    file.write(reinterpret_cast<const char*>(records.data()),
+               static_cast<std::streamsize>(records.size() * sizeof(QuestionRecord)));
+    writePadding(file, header.recordsOffset + records.size() * sizeof(QuestionRecord), header.indexOffset);
+    file.write(reinterpret_cast<const char*>(index.data()),
+               static_cast<std::streamsize>(index.size() * sizeof(QuestionIndexEntry)));
+    writePadding(file, header.indexOffset + index.size() * sizeof(QuestionIndexEntry), header.stringsOffset);
+    file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    if (!file.good()) {
+        error = "write to " + path + " failed";
+        return false;
+    }
+    return true;
+}
+
+MappedQuestionBank::MappedQuestionBank()
+    : base(nullptr), mappedSize(0), header(nullptr), records(nullptr), index(nullptr), stringTable(nullptr) {
+}
+
+MappedQuestionBank::~MappedQuestionBank() {
+    close();
+}
+
+bool MappedQuestionBank::isCompiledBank(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(QuestionBankFormat::MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, QuestionBankFormat::MAGIC, sizeof(magic)) == 0;
+}
+
+bool MappedQuestionBank::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        std::cerr << "Cannot open question bank " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || static_cast<size_t>(info.st_size) < sizeof(QuestionBankHeader)) {
+        std::cerr << "Question bank " << path << " is too short." << std::endl;
+        ::close(fd);
+        return false;
+    }
+    size_t fileSize = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Cannot map question bank " << path << std::endl;
+        return false;
+    }
+
+    const QuestionBankHeader* candidate = static_cast<const QuestionBankHeader*>(mapping);
+    uint64_t count = candidate->questionCount;
+    bool valid = std::memcmp(candidate->magic, QuestionBankFormat::MAGIC, sizeof(candidate->magic)) == 0
+                 && candidate->version == QuestionBankFormat::VERSION
+                 && candidate->recordsOffset % 8 == 0 && candidate->indexOffset % 8 == 0
+                 && candidate->recordsOffset + count * sizeof(QuestionRecord) <= fileSize
+                 && candidate->indexOffset + count * sizeof(QuestionIndexEntry) <= fileSize
+                 && candidate->stringsOffset <= fileSize
+                 && candidate->stringsSize <= fileSize - candidate->stringsOffset;
+    if (!valid) {
+        std::cerr << "Question bank " << path << " is damaged or from another version." << std::endl;
+        munmap(mapping, fileSize);
+        return false;
+    }
+    // Questions are sampled at random; read-ahead would only waste page cache
+    madvise(mapping, fileSize, MADV_RANDOM);
+
+    base = mapping;
+    mappedSize = fileSize;
+    header = candidate;
+    const char* bytes = static_cast<const char*>(mapping);
+    records = reinterpret_cast<const QuestionRecord*>(bytes + header->recordsOffset);
+    index = reinterpret_cast<const QuestionIndexEntry*>(bytes + header->indexOffset);
+    stringTable = bytes + header->stringsOffset;
+    return true;
+}
+
+void MappedQuestionBank::close() {
+    if (base) {
+        munmap(base, mappedSize);
+    }
+    base = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+    records = nullptr;
+    index = nullptr;
+    stringTable = nullptr;
+}
+
+long MappedQuestionBank::find(int questionId) const {
+    const QuestionIndexEntry* end = index + size();
+    const QuestionIndexEntry* it = std::lower_bound(index, end, questionId,
+        [](const QuestionIndexEntry& entry, int id) { return entry.questionId < id; });
+    if (it == end || it->questionId != questionId || it->position >= size()) {
+        return -1;
+    }
+    return static_cast<long>(it->position);
+}
+
+bool MappedQuestionBank::strings(const QuestionRecord& record, std::string_view& text, std::string_view* options) const {
+    if (record.optionCount > QuestionBankFormat::MAX_OPTIONS) {
+        return false;
+    }
+    uint64_t end = static_cast<uint64_t>(record.stringsOffset) + record.textLength;
+    for (uint8_t i = 0; i < record.optionCount; ++i) {
+        end += record.optionLengths[i];
+    }
+    if (end > header->stringsSize) {
+        return false;
+    }
+    const char* cursor = stringTable + record.stringsOffset;
+    text = std::string_view(cursor, record.textLength);
+    cursor += record.textLength;
+    for (uint8_t i = 0; i < record.optionCount; ++i) {
+        options[i] = std::string_view(cursor, record.optionLengths[i]);
+        cursor += record.optionLengths[i];
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef QUESTION_BANK_H
+#define QUESTION_BANK_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Compiled question bank (.qbank): a read-only binary image of a question
+// text file, produced offline by build/question_compiler and mapped into
+// memory by the server. Several server processes mapping the same file
+// share its pages through the page cache.
+//
+// Layout (native byte order, every section 8-byte aligned):
+//   QuestionBankHeader
+//   QuestionRecord[questionCount]       in the order of the text file
+//   QuestionIndexEntry[questionCount]   sorted by questionId
+//   string table                        raw bytes, not NUL-terminated
+namespace QuestionBankFormat {
+    const char MAGIC[8] = {'Q', 'B', 'A', 'N', 'K', '\0', '\0', '\0'};
+    const uint32_t VERSION = 1;
+    const size_t MAX_OPTIONS = 4;
+    const size_t MAX_STRING_LENGTH = 65535;
+}
+
+struct QuestionBankHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t questionCount;
+    uint64_t recordsOffset;
+    uint64_t indexOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+// A question's text and options are stored back to back in the string
+// table starting at stringsOffset
+struct QuestionRecord {
+    int32_t questionId;
+    uint32_t stringsOffset;
+    uint16_t textLength;
+    uint8_t optionCount;
+    int8_t correctAnswerIndex;
+    uint16_t optionLengths[QuestionBankFormat::MAX_OPTIONS];
+};
+static_assert(sizeof(QuestionRecord) == 20, "QuestionRecord is part of the file format");
+
+struct QuestionIndexEntry {
+    int32_t questionId;
+    uint32_t position;   // into the record array
+};
+
+// One question as the compiler reads it from the text file
+struct QuestionSource {
+    int questionId;
+    std::string questionText;
+    std::vector<std::string> options;
+    int correctAnswerIndex;
+};
+
+// Writes a compiled bank; on failure returns false and describes why in error
+bool writeQuestionBank(const std::string& path, const std::vector<QuestionSource>& questions, std::string& error);
+
+// Read-only view of a mapped .qbank file. Only the header and section
+// bounds are checked when the file is opened, so opening costs the same
+// for any bank size; each record's strings are checked when it is read.
+class MappedQuestionBank {
+public:
+    MappedQuestionBank();
+    ~MappedQuestionBank();
+    MappedQuestionBank(const MappedQuestionBank&) = delete;
+    MappedQuestionBank& operator=(const MappedQuestionBank&) = delete;
+
+    // True if the file starts with the compiled bank magic
+    static bool isCompiledBank(const std::string& path);
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    size_t size() const { return header ? header->questionCount : 0; }
+    const QuestionRecord& record(size_t position) const { return records[position]; }
+    // Bank position of the question with this id, or -1
+    long find(int questionId) const;
+    // The record's text and options (options needs MAX_OPTIONS entries);
+    // false if they run outside the string table
+    bool strings(const QuestionRecord& record, std::string_view& text, std::string_view* options) const;
+
+private:
+    void* base;
+    size_t mappedSize;
+    const QuestionBankHeader* header;
+    const QuestionRecord* records;
+    const QuestionIndexEntry* index;
+    const char* stringTable;
+};
+
+#endif
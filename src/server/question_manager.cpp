@@ -5,8 +5,13 @@
 #include <algorithm>
 #include <chrono>
 
+namespace {
+    const size_t MIN_MATERIALIZED_SWEEP = 1024;
+}
+
 QuestionManager::QuestionManager(const std::string& dataFile) 
-    : questionDataFile(dataFile), nextQuestionId(1) {
+    : materializedSweepAt(MIN_MATERIALIZED_SWEEP), readOnly(MappedQuestionBank::isCompiledBank(dataFile)),
+      questionDataFile(dataFile), nextQuestionId(1) {
     
     auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
     rng.seed(static_cast<unsigned int>(seed));
@@ -14,20 +19,66 @@ QuestionManager::QuestionManager(const std::string& dataFile)
     loadQuestionsFromFile();
     
     // Initialize with default questions if no questions loaded
-    if (questions.empty()) {
+    if (bankSize() == 0 && !readOnly) {
         initializeDefaultQuestions();
         saveQuestionsToFile();
     }
     
-    std::cout << "Question manager initialized with " << questions.size() << " questions." << std::endl;
+    std::cout << "Question manager initialized with " << bankSize() << " questions." << std::endl;
 }
 
 QuestionManager::~QuestionManager() {
-    saveQuestionsToFile();
+    if (!readOnly) {
+        saveQuestionsToFile();
+    }
     std::cout << "Question manager shutting down." << std::endl;
 }
 
+// Builds the shared question and pre-encodes the parts of its QUESTION frame
+// that never change, so serving it only formats the position and time left
+QuestionHandle QuestionManager::makeQuestion(int questionId, const std::string& questionText,
+                                             const std::vector<std::string>& options, int correctAnswerIndex) {
+    Question question(questionId, questionText, options, correctAnswerIndex);
+    question.textSegment = std::make_shared<const std::string>("|" + questionText + "|");
+    std::string optionList;
+    for (size_t i = 0; i < options.size(); ++i) {
+        optionList += "|" + std::to_string(i + 1) + "." + options[i];
+    }
+    optionList += "\n";
+    question.optionsSegment = std::make_shared<const std::string>(std::move(optionList));
+    return std::make_shared<const Question>(std::move(question));
+}
+
+bool QuestionManager::parseQuestionLine(const std::string& line, QuestionSource& question) {
+    std::istringstream iss(line);
+    std::string option1, option2, option3, option4;
+    
+    if (!(std::getline(iss, question.questionText, '|') &&
+          std::getline(iss, option1, '|') &&
+          std::getline(iss, option2, '|') &&
+          std::getline(iss, option3, '|') &&
+          std::getline(iss, option4, '|') &&
+          iss >> question.questionId >> question.correctAnswerIndex)) {
+        return false;
+    }
+    auto has_newline = [](const std::string& s) { return s.find('\n') != std::string::npos || s.find('\r') != std::string::npos; };
+    if (has_newline(question.questionText) || has_newline(option1) || has_newline(option2) || has_newline(option3) || has_newline(option4)) {
+        std::cout << "[Warning] Skipping question with embedded newline: " << question.questionText << std::endl;
+        return false;
+    }
+    question.options = {option1, option2, option3, option4};
+    return true;
+}
+
 bool QuestionManager::loadQuestionsFromFile() {
+    if (readOnly) {
+        if (!compiledBank.open(questionDataFile)) {
+            return false;
+        }
+        std::cout << "Mapped " << compiledBank.size() << " questions from compiled bank " << questionDataFile << "." << std::endl;
+        return true;
+    }
+
     std::ifstream file(questionDataFile);
     if (!file.is_open()) {
         std::cout << "No existing question file found. Will create default questions." << std::endl;
@@ -35,39 +86,81 @@ bool QuestionManager::loadQuestionsFromFile() {
     }
     
     std::string line;
+    QuestionSource source;
     while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string questionText, option1, option2, option3, option4;
-        int questionId, correctAnswerIndex;
-        
-        if (std::getline(iss, questionText, '|') &&
-            std::getline(iss, option1, '|') &&
-            std::getline(iss, option2, '|') &&
-            std::getline(iss, option3, '|') &&
-            std::getline(iss, option4, '|') &&
-            iss >> questionId >> correctAnswerIndex) {
-            auto has_newline = [](const std::string& s) { return s.find('\n') != std::string::npos || s.find('\r') != std::string::npos; };
-            if (has_newline(questionText) || has_newline(option1) || has_newline(option2) || has_newline(option3) || has_newline(option4)) {
-                std::cout << "[Warning] Skipping question with embedded newline: " << questionText << std::endl;
-                continue;
-            }
-            std::vector<std::string> options = {option1, option2, option3, option4};
-            Question question(questionId, questionText, options, correctAnswerIndex);
-            questions.push_back(question);
-            questionMap[questionId] = question;
+        if (parseQuestionLine(line, source)) {
+            questions.push_back(makeQuestion(source.questionId, source.questionText, source.options,
+                                             source.correctAnswerIndex));
             
-            if (questionId >= nextQuestionId) {
-                nextQuestionId = questionId + 1;
+            if (source.questionId >= nextQuestionId) {
+                nextQuestionId = source.questionId + 1;
             }
         }
     }
+    indexQuestions();
     
     file.close();
     std::cout << "Loaded " << questions.size() << " questions from file." << std::endl;
     return true;
 }
 
+void QuestionManager::indexQuestions() {
+    positionById.clear();
+    for (size_t i = 0; i < questions.size(); ++i) {
+        positionById[questions[i]->getQuestionId()] = i;
+    }
+}
+
+size_t QuestionManager::bankSize() const {
+    return compiledBank.isOpen() ? compiledBank.size() : questions.size();
+}
+
+long QuestionManager::findPosition(int questionId) const {
+    if (compiledBank.isOpen()) {
+        return compiledBank.find(questionId);
+    }
+    auto it = positionById.find(questionId);
+    return it != positionById.end() ? static_cast<long>(it->second) : -1;
+}
+
+// Builds a question straight from its compiled record; nullptr if the record is damaged
+QuestionHandle QuestionManager::readCompiled(size_t position) const {
+    const QuestionRecord& record = compiledBank.record(position);
+    std::string_view text;
+    std::string_view optionText[QuestionBankFormat::MAX_OPTIONS];
+    if (!compiledBank.strings(record, text, optionText)) {
+        return nullptr;
+    }
+    std::vector<std::string> options(optionText, optionText + record.optionCount);
+    return makeQuestion(record.questionId, std::string(text), options, record.correctAnswerIndex);
+}
+
+QuestionHandle QuestionManager::questionAt(size_t position) {
+    if (!compiledBank.isOpen()) {
+        return questions[position];
+    }
+    std::weak_ptr<const Question>& entry = materialized[static_cast<uint32_t>(position)];
+    QuestionHandle question = entry.lock();
+    if (question) {
+        return question;
+    }
+    question = readCompiled(position);
+    entry = question;
+    if (materialized.size() >= materializedSweepAt) {
+        // Drop questions no game holds any more; sweeping again only once the
+        // map has doubled keeps this amortized O(1) per draw
+        for (auto it = materialized.begin(); it != materialized.end();) {
+            it = it->second.expired() ? materialized.erase(it) : std::next(it);
+        }
+        materializedSweepAt = std::max(MIN_MATERIALIZED_SWEEP, 2 * materialized.size());
+    }
+    return question;
+}
+
 bool QuestionManager::saveQuestionsToFile() const {
+    if (readOnly) {
+        return false;
+    }
     std::ofstream file(questionDataFile);
     if (!file.is_open()) {
         std::cerr << "Failed to open question file for writing." << std::endl;
@@ -75,13 +168,14 @@ bool QuestionManager::saveQuestionsToFile() const {
     }
     
     for (const auto& question : questions) {
-        file << question.getQuestionText() << "|"
-             << question.getOptions()[0] << "|"
-             << question.getOptions()[1] << "|"
-             << question.getOptions()[2] << "|"
-             << question.getOptions()[3] << "|"
-             << question.getQuestionId() << " "
-             << question.getCorrectAnswerIndex() << std::endl;
+        const auto& options = question->getOptions();
+        file << question->getQuestionText() << "|"
+             << options[0] << "|"
+             << options[1] << "|"
+             << options[2] << "|"
+             << options[3] << "|"
+             << question->getQuestionId() << " "
+             << question->getCorrectAnswerIndex() << std::endl;
     }
     
     file.close();
@@ -91,14 +185,15 @@ bool QuestionManager::saveQuestionsToFile() const {
 bool QuestionManager::addQuestion(const std::string& questionText, 
                                  const std::vector<std::string>& options, 
                                  int correctAnswerIndex) {
-    if (options.size() != 4 || correctAnswerIndex < 0 || correctAnswerIndex >= 4) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (readOnly || options.size() != 4 || correctAnswerIndex < 0 || correctAnswerIndex >= 4) {
         return false;
     }
     
     int questionId = generateQuestionId();
-    Question newQuestion(questionId, questionText, options, correctAnswerIndex);
+    auto newQuestion = makeQuestion(questionId, questionText, options, correctAnswerIndex);
+    positionById[questionId] = questions.size();
     questions.push_back(newQuestion);
-    questionMap[questionId] = newQuestion;
     
     saveQuestionsToFile();
     std::cout << "Question added: " << questionText << " (ID: " << questionId << ")" << std::endl;
@@ -106,72 +201,99 @@ bool QuestionManager::addQuestion(const std::string& questionText,
 }
 
 bool QuestionManager::removeQuestion(int questionId) {
-    auto it = questionMap.find(questionId);
-    if (it == questionMap.end()) {
+    std::lock_guard<std::mutex> lock(mutex);
+    long position = readOnly ? -1 : findPosition(questionId);
+    if (position < 0) {
         return false;
     }
     
-    questions.erase(std::remove_if(questions.begin(), questions.end(),
-                                  [questionId](const Question& q) { return q.getQuestionId() == questionId; }),
-                   questions.end());
-    questionMap.erase(it);
+    questions.erase(questions.begin() + position);
+    indexQuestions();
     
     saveQuestionsToFile();
     std::cout << "Question removed: " << questionId << std::endl;
     return true;
 }
 
-Question* QuestionManager::getQuestion(int questionId) {
-    auto it = questionMap.find(questionId);
-    if (it != questionMap.end()) {
-        return &(it->second);
-    }
-    return nullptr;
+QuestionHandle QuestionManager::getQuestion(int questionId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    long position = findPosition(questionId);
+    return position >= 0 ? questionAt(static_cast<size_t>(position)) : nullptr;
 }
 
-Question* QuestionManager::getRandomQuestion() {
-    if (questions.empty()) {
+QuestionHandle QuestionManager::getRandomQuestion() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bankSize() == 0) {
         return nullptr;
     }
     
-    std::uniform_int_distribution<int> dist(0, static_cast<int>(questions.size()) - 1);
-    int randomIndex = dist(rng);
-    return &questions[randomIndex];
+    std::uniform_int_distribution<size_t> dist(0, bankSize() - 1);
+    return questionAt(dist(rng));
 }
 
-std::vector<Question> QuestionManager::getRandomQuestions(int count) {
-    std::vector<Question> result;
-    if (questions.empty()) {
+// Games get handles to the bank's questions; nothing is copied. Sampling is
+// a partial Fisher-Yates shuffle of sampleOrder: each pick swaps a random
+// not-yet-picked position to the front. The permutation is kept for the
+// next game, so a game start costs O(count) however large the bank is.
+std::vector<QuestionHandle> QuestionManager::getRandomQuestions(int count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<QuestionHandle> result;
+    size_t size = bankSize();
+    if (size == 0 || count <= 0) {
         return result;
     }
     
-    count = std::min(count, static_cast<int>(questions.size()));
-    std::vector<int> indices(questions.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    
-    std::shuffle(indices.begin(), indices.end(), rng);
+    // Any permutation of the positions will do, so only a change in the
+    // bank's size needs fixing up
+    if (sampleOrder.size() > size) {
+        sampleOrder.clear();
+    }
+    for (size_t i = sampleOrder.size(); i < size; ++i) {
+        sampleOrder.push_back(static_cast<uint32_t>(i));
+    }
     
-    for (int i = 0; i < count; ++i) {
-        result.push_back(questions[indices[i]]);
+    size_t picks = std::min(static_cast<size_t>(count), size);
+    result.reserve(picks);
+    for (size_t i = 0; i < picks; ++i) {
+        std::uniform_int_distribution<size_t> dist(i, size - 1);
+        std::swap(sampleOrder[i], sampleOrder[dist(rng)]);
+        QuestionHandle question = questionAt(sampleOrder[i]);
+        if (question) {
+            result.push_back(std::move(question));
+        }
     }
     
     return result;
 }
 
-std::vector<Question> QuestionManager::getAllQuestions() const {
-    return questions;
+std::vector<QuestionHandle> QuestionManager::getAllQuestions() const {
+    if (!compiledBank.isOpen()) {
+        return questions;
+    }
+    std::vector<QuestionHandle> all;
+    all.reserve(compiledBank.size());
+    for (size_t i = 0; i < compiledBank.size(); ++i) {
+        QuestionHandle question = readCompiled(i);
+        if (question) {
+            all.push_back(std::move(question));
+        }
+    }
+    return all;
 }
 
 bool QuestionManager::validateAnswer(int questionId, int answerIndex) const {
-    auto it = questionMap.find(questionId);
-    if (it != questionMap.end()) {
-        return it->second.isCorrectAnswer(answerIndex);
+    long position = findPosition(questionId);
+    if (position < 0) {
+        return false;
+    }
+    if (compiledBank.isOpen()) {
+        return compiledBank.record(static_cast<size_t>(position)).correctAnswerIndex == answerIndex;
     }
-    return false;
+    return questions[static_cast<size_t>(position)]->isCorrectAnswer(answerIndex);
 }
 
 bool QuestionManager::questionExists(int questionId) const {
-    return questionMap.find(questionId) != questionMap.end();
+    return findPosition(questionId) >= 0;
 }
 
 void QuestionManager::initializeDefaultQuestions() {
@@ -192,10 +314,11 @@ void QuestionManager::initializeDefaultQuestions() {
     
     for (size_t i = 0; i < defaultQuestions.size(); ++i) {
         int questionId = generateQuestionId();
-        Question question(questionId, defaultQuestions[i].first, defaultQuestions[i].second, correctAnswers[i]);
+        auto question = makeQuestion(questionId, defaultQuestions[i].first, defaultQuestions[i].second,
+                                     correctAnswers[i]);
         questions.push_back(question);
-        questionMap[questionId] = question;
     }
+    indexQuestions();
     
     std::cout << "Initialized with " << questions.size() << " default questions." << std::endl;
 } 
\ No newline at end of file
@@ -3,22 +3,48 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <memory>
 #include <random>
+#include <mutex>
+#include <cstdint>
 #include "../common/question.h"
+#include "question_bank.h"
 
+// Serves questions from either a text file ("text|opt1|..|opt4|id correct"
+// per line) or a compiled .qbank file. A compiled bank is mapped read-only
+// and its questions are only built while some game holds them.
 class QuestionManager {
 private:
-    std::vector<Question> questions;  
-    std::map<int, Question> questionMap;
+    std::vector<QuestionHandle> questions;   // text bank; empty when a compiled bank is used
+    std::unordered_map<int, size_t> positionById;   // text bank: questionId -> position in questions
+    MappedQuestionBank compiledBank;
+    // Compiled bank questions built for running games, by position. The games
+    // hold the only strong references, so a question no game uses is freed
+    std::unordered_map<uint32_t, std::weak_ptr<const Question>> materialized;
+    size_t materializedSweepAt;   // size at which expired entries are next dropped
+    bool readOnly;   // loaded from a compiled bank, which is never written back
+    std::vector<uint32_t> sampleOrder;   // permutation of bank positions, reshuffled in part per game
     std::string questionDataFile;  
     int nextQuestionId; 
     std::mt19937 rng;  
+    std::mutex mutex;   // guards the bank and rng; shared by every server shard
+
+    static QuestionHandle makeQuestion(int questionId, const std::string& questionText,
+                                       const std::vector<std::string>& options, int correctAnswerIndex);
+    size_t bankSize() const;
+    long findPosition(int questionId) const;
+    QuestionHandle readCompiled(size_t position) const;
+    QuestionHandle questionAt(size_t position);   // caller holds mutex
+    void indexQuestions();
 
 public:
     QuestionManager(const std::string& dataFile = "data/questions.txt");
     ~QuestionManager();
 
+    // Parses one line of the text format; false if it is malformed
+    static bool parseQuestionLine(const std::string& line, QuestionSource& question);
+
     bool loadQuestionsFromFile();
     bool saveQuestionsToFile() const;
     bool addQuestion(const std::string& questionText, 
@@ -27,17 +53,20 @@ public:
     bool removeQuestion(int questionId);
     
     // Question serving
-    Question* getQuestion(int questionId);
-    Question* getRandomQuestion();
-    std::vector<Question> getRandomQuestions(int count);
-    std::vector<Question> getAllQuestions() const;
+    QuestionHandle getQuestion(int questionId);
+    QuestionHandle getRandomQuestion();
+    std::vector<QuestionHandle> getRandomQuestions(int count);
+    std::vector<QuestionHandle> getAllQuestions() const;
     
     // Question validation
     bool validateAnswer(int questionId, int answerIndex) const;
     bool questionExists(int questionId) const;
     
-    int getQuestionCount() const { return static_cast<int>(questions.size()); }
-    void clearQuestions() { questions.clear(); questionMap.clear(); nextQuestionId = 1; }
+    int getQuestionCount() const { return static_cast<int>(bankSize()); }
+    bool isCompiled() const { return compiledBank.isOpen(); }
+    void clearQuestions() {
+        questions.clear(); positionById.clear(); compiledBank.close(); materialized.clear(); nextQuestionId = 1;
+    }
     
     int generateQuestionId() { return nextQuestionId++; }
     
@@ -0,0 +1,152 @@
+#include "reactor.h"
+#include <map>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include <errno.h>
+
+namespace {
+
+class EpollReactor : public Reactor {
+private:
+    int epollFd;
+    std::vector<epoll_event> events;
+
+    static uint32_t toEpoll(unsigned flags) {
+        uint32_t ev = EPOLLET | EPOLLRDHUP;
+        if (flags & EVENT_READ) ev |= EPOLLIN;
+        if (flags & EVENT_WRITE) ev |= EPOLLOUT;
+        return ev;
+    }
+
+    bool control(int op, int fd, unsigned flags) {
+        epoll_event ev{};
+        ev.events = toEpoll(flags);
+        ev.data.fd = fd;
+        return epoll_ctl(epollFd, op, fd, &ev) == 0;
+    }
+
+public:
+    EpollReactor() : epollFd(epoll_create1(EPOLL_CLOEXEC)), events(256) {
+        if (epollFd == -1) {
+            std::cerr << "epoll_create1 failed with error: " << errno << std::endl;
+        }
+    }
+
+    ~EpollReactor() override {
+        if (epollFd != -1) close(epollFd);
+    }
+
+    bool valid() const { return epollFd != -1; }
+
+    bool add(int fd, unsigned flags) override { return control(EPOLL_CTL_ADD, fd, flags); }
+    bool modify(int fd, unsigned flags) override { return control(EPOLL_CTL_MOD, fd, flags); }
+    bool remove(int fd) override { return epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) == 0; }
+
+    int wait(std::vector<ReactorEvent>& ready, int timeoutMs) override {
+        ready.clear();
+        int n = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), timeoutMs);
+        if (n == -1) {
+            return errno == EINTR ? 0 : -1;
+        }
+        for (int i = 0; i < n; ++i) {
+            unsigned flags = 0;
+            uint32_t ev = events[i].events;
+            if (ev & EPOLLIN) flags |= EVENT_READ;
+            if (ev & EPOLLOUT) flags |= EVENT_WRITE;
+            if (ev & (EPOLLHUP | EPOLLRDHUP)) flags |= EVENT_HANGUP;
+            if (ev & EPOLLERR) flags |= EVENT_ERROR;
+            ready.push_back({events[i].data.fd, flags});
+        }
+        // A full batch means more sockets may be ready; grow for the next wakeup
+        if (n == static_cast<int>(events.size())) {
+            events.resize(events.size() * 2);
+        }
+        return n;
+    }
+
+    const char* name() const override { return "epoll"; }
+};
+
+class SelectReactor : public Reactor {
+private:
+    std::map<int, unsigned> interest;  // fd -> requested flags, ordered so the max fd is last
+
+public:
+    bool add(int fd, unsigned flags) override {
+        if (fd < 0 || fd >= FD_SETSIZE) {
+            std::cerr << "select backend cannot watch fd " << fd << " (FD_SETSIZE=" << FD_SETSIZE << ")" << std::endl;
+            return false;
+        }
+        return interest.emplace(fd, flags).second;
+    }
+
+    bool modify(int fd, unsigned flags) override {
+        auto it = interest.find(fd);
+        if (it == interest.end()) return false;
+        it->second = flags;
+        return true;
+    }
+
+    bool remove(int fd) override { return interest.erase(fd) > 0; }
+
+    int wait(std::vector<ReactorEvent>& ready, int timeoutMs) override {
+        ready.clear();
+        fd_set readFds, writeFds;
+        FD_ZERO(&readFds);
+        FD_ZERO(&writeFds);
+        for (const auto& [fd, flags] : interest) {
+            if (flags & EVENT_READ) FD_SET(fd, &readFds);
+            if (flags & EVENT_WRITE) FD_SET(fd, &writeFds);
+        }
+        int maxfd = interest.empty() ? -1 : interest.rbegin()->first;
+
+        timeval tv;
+        timeval* tvp = nullptr;
+        if (timeoutMs >= 0) {
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            tvp = &tv;
+        }
+        int activity = select(maxfd + 1, &readFds, &writeFds, NULL, tvp);
+        if (activity == -1) {
+            return errno == EINTR ? 0 : -1;
+        }
+        for (const auto& [fd, flags] : interest) {
+            if (static_cast<int>(ready.size()) == activity) break;
+            unsigned out = 0;
+            if ((flags & EVENT_READ) && FD_ISSET(fd, &readFds)) out |= EVENT_READ;
+            if ((flags & EVENT_WRITE) && FD_ISSET(fd, &writeFds)) out |= EVENT_WRITE;
+            if (out) ready.push_back({fd, out});
+        }
+        return static_cast<int>(ready.size());
+    }
+
+    const char* name() const override { return "select"; }
+};
+
+} // namespace
+
+std::unique_ptr<Reactor> createReactor(ReactorBackend backend) {
+    if (backend == ReactorBackend::EPOLL) {
+        auto reactor = std::make_unique<EpollReactor>();
+        if (reactor->valid()) {
+            return reactor;
+        }
+        std::cerr << "Falling back to select reactor." << std::endl;
+    }
+    return std::make_unique<SelectReactor>();
+}
+
+bool parseReactorBackend(const std::string& name, ReactorBackend& backend) {
+    if (name == "epoll") {
+        backend = ReactorBackend::EPOLL;
+        return true;
+    }
+    if (name == "select") {
+        backend = ReactorBackend::SELECT;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+// Readiness flags requested from and reported by a Reactor
+enum ReactorEventFlags : unsigned {
+    EVENT_READ = 1u << 0,
+    EVENT_WRITE = 1u << 1,
+    EVENT_HANGUP = 1u << 2,
+    EVENT_ERROR = 1u << 3
+};
+
+struct ReactorEvent {
+    int fd;
+    unsigned events;
+};
+
+enum class ReactorBackend {
+    EPOLL,
+    SELECT
+};
+
+// Socket readiness multiplexer used by the server event loop.
+// The epoll backend is edge-triggered, so callers must drain a ready
+// socket (accept/recv until EAGAIN) before waiting on it again. The
+// select backend is level-triggered and limited to FD_SETSIZE sockets.
+class Reactor {
+public:
+    virtual ~Reactor() {}
+
+    virtual bool add(int fd, unsigned events) = 0;
+    virtual bool modify(int fd, unsigned events) = 0;
+    virtual bool remove(int fd) = 0;
+
+    // Waits up to timeoutMs (-1 blocks) and replaces `ready` with the ready sockets.
+    // Returns the number of ready sockets, or -1 on a fatal error.
+    virtual int wait(std::vector<ReactorEvent>& ready, int timeoutMs) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+std::unique_ptr<Reactor> createReactor(ReactorBackend backend);
+bool parseReactorBackend(const std::string& name, ReactorBackend& backend);
+
+#endif
@@ -3,7 +3,9 @@
 #include <iostream>
 #include "../common/game_state.h"
 
-RoomManager::RoomManager() : nextRoomId(1) {
+RoomManager::RoomManager(PlayerDirectory& directory, int firstId, int idStride)
+    : players(directory), firstRoomId(firstId), roomIdStride(idStride), nextRoomId(firstId),
+      arenaCapacity(GameConstants::DEFAULT_ARENA_CAPACITY) {
     std::cout << "Room manager initialized." << std::endl;
 }
 
@@ -11,51 +13,61 @@ RoomManager::~RoomManager() {
     std::cout << "Room manager shutting down." << std::endl;
 }
 
-int RoomManager::createRoom(const std::string& roomName, const std::string& hostUsername) {
+int RoomManager::createRoom(const std::string& roomName, PlayerId host, RoomKind kind) {
     // Validate room name
     if (roomName.empty() || roomName.length() > 50) {
         return -1;
     }
     
     // Check if user is already in a room
-    if (isUserInRoom(hostUsername)) {
+    if (isUserInRoom(host)) {
         return -1;
     }
     
-    // Create new room
+    // Create new room; the claim fails if another shard put the host in a room meanwhile
     int roomId = generateRoomId();
-    Room newRoom(roomId, roomName, hostUsername);
-    newRoom.addPlayer(hostUsername);
-    rooms[roomId] = newRoom;
+    if (!players.claimRoom(host, roomId)) {
+        return -1;
+    }
+    int capacity = (kind == RoomKind::ARENA) ? arenaCapacity : GameConstants::MAX_PLAYERS_PER_ROOM;
+    Room& newRoom = rooms[roomId];
+    newRoom = Room(roomId, roomName, host, kind, capacity);
+    newRoom.addPlayer(host);
     
-    std::cout << "Room created: " << roomName << " (ID: " << roomId << ") by " << hostUsername << std::endl;
+    std::cout << (kind == RoomKind::ARENA ? "Arena created: " : "Room created: ") << roomName
+              << " (ID: " << roomId << ") by " << players.nameOf(host) << std::endl;
     return roomId;
 }
 
-JoinRoomResult RoomManager::joinRoom(int roomId, const std::string& username) {
+JoinRoomResult RoomManager::joinRoom(int roomId, PlayerId player) {
     auto it = rooms.find(roomId);
     if (it == rooms.end()) {
         return JoinRoomResult::ROOM_NOT_FOUND;
     }
     Room& room = it->second;
-    if (room.getPlayerCount() >= GameConstants::MAX_PLAYERS_PER_ROOM) {
+    if (room.isFull()) {
         return JoinRoomResult::ROOM_FULL;
     }
     if (room.isGameInProgress()) {
         return JoinRoomResult::GAME_IN_PROGRESS;
     }
-    if (isUserInRoom(username)) {
+    if (isUserInRoom(player)) {
         return JoinRoomResult::USER_ALREADY_IN_ROOM;
     }
-    if (room.hasPlayer(username)) {
+    if (room.hasPlayer(player)) {
         return JoinRoomResult::USER_ALREADY_IN_THIS_ROOM;
     }
-    room.addPlayer(username);
-    std::cout << "User " << username << " joined room " << roomId << std::endl;
+    if (!players.claimRoom(player, roomId)) {
+        return JoinRoomResult::USER_ALREADY_IN_ROOM;   // joined a room on another shard meanwhile
+    }
+    room.addPlayer(player);
+    if (!room.isArena()) {
+        std::cout << "User " << players.nameOf(player) << " joined room " << roomId << std::endl;
+    }
     return JoinRoomResult::SUCCESS;
 }
 
-bool RoomManager::leaveRoom(int roomId, const std::string& username) {
+bool RoomManager::leaveRoom(int roomId, PlayerId player) {
     auto it = rooms.find(roomId);
     if (it == rooms.end()) {
         return false;
@@ -63,23 +75,26 @@ bool RoomManager::leaveRoom(int roomId, const std::string& username) {
     
     Room& room = it->second;
     
-    if (!room.hasPlayer(username)) {
+    if (!room.hasPlayer(player)) {
         return false;
     }
     
-    room.removePlayer(username);
+    room.removePlayer(player);
+    players.releaseRoom(player, roomId);
     
     if (room.getPlayerCount() == 0) {
         rooms.erase(it);
         std::cout << "Room " << roomId << " deleted (empty)." << std::endl;
     } else {
-        if (room.getHostUsername() == username) {
+        if (room.getHostId() == player) {
             if (room.getPlayerCount() > 0) {
-                room.hostUsername = room.getPlayers()[0];
-                std::cout << "New host for room " << roomId << ": " << room.getHostUsername() << std::endl;
+                room.hostId = room.getPlayers()[0];
+                std::cout << "New host for room " << roomId << ": " << players.nameOf(room.getHostId()) << std::endl;
             }
         }
-        std::cout << "User " << username << " left room " << roomId << std::endl;
+        if (!room.isArena()) {
+            std::cout << "User " << players.nameOf(player) << " left room " << roomId << std::endl;
+        }
     }
     
     return true;
@@ -88,6 +103,9 @@ bool RoomManager::leaveRoom(int roomId, const std::string& username) {
 bool RoomManager::deleteRoom(int roomId) {
     auto it = rooms.find(roomId);
     if (it != rooms.end()) {
+        for (PlayerId player : it->second.getPlayers()) {
+            players.releaseRoom(player, roomId);
+        }
         rooms.erase(it);
         std::cout << "Room " << roomId << " deleted." << std::endl;
         return true;
@@ -111,12 +129,12 @@ std::vector<Room> RoomManager::getAllRooms() const {
     return roomList;
 }
 
-std::vector<Room> RoomManager::getAvailableRooms() const {
-    std::vector<Room> availableRooms;
+std::vector<const Room*> RoomManager::getAvailableRooms() const {
+    std::vector<const Room*> availableRooms;
     for (const auto& pair : rooms) {
         const Room& room = pair.second;
-        if (room.isWaiting() && room.getPlayerCount() < GameConstants::MAX_PLAYERS_PER_ROOM) {
-            availableRooms.push_back(room);
+        if (room.isWaiting() && !room.isFull()) {
+            availableRooms.push_back(&room);
         }
     }
     return availableRooms;
@@ -126,25 +144,25 @@ bool RoomManager::roomExists(int roomId) const {
     return rooms.find(roomId) != rooms.end();
 }
 
-bool RoomManager::isUserInRoom(const std::string& username) const {
-    for (const auto& pair : rooms) {
-        if (pair.second.hasPlayer(username)) {
-            return true;
-        }
-    }
-    return false;
+bool RoomManager::isUserInRoom(PlayerId player) const {
+    return players.roomOf(player) != -1;
+}
+
+int RoomManager::getUserRoomId(PlayerId player) const {
+    return players.roomOf(player);
 }
 
-int RoomManager::getUserRoomId(const std::string& username) const {
+void RoomManager::clearRooms() {
     for (const auto& pair : rooms) {
-        if (pair.second.hasPlayer(username)) {
-            return pair.first;
+        for (PlayerId player : pair.second.getPlayers()) {
+            players.releaseRoom(player, pair.first);
         }
     }
-    return -1;
+    rooms.clear();
+    nextRoomId = firstRoomId;
 }
 
-bool RoomManager::startGame(int roomId, const std::string& hostUsername) {
+bool RoomManager::startGame(int roomId, PlayerId host) {
     auto it = rooms.find(roomId);
     if (it == rooms.end()) {
         return false;
@@ -152,7 +170,7 @@ bool RoomManager::startGame(int roomId, const std::string& hostUsername) {
     
     Room& room = it->second;
     
-    if (room.getHostUsername() != hostUsername) {
+    if (room.getHostId() != host) {
         return false;
     }
     
@@ -192,12 +210,12 @@ bool RoomManager::isGameInProgress(int roomId) const {
     return false;
 }
 
-std::vector<std::string> RoomManager::getRoomPlayers(int roomId) const {
+std::vector<PlayerId> RoomManager::getRoomPlayers(int roomId) const {
     auto it = rooms.find(roomId);
     if (it != rooms.end()) {
         return it->second.getPlayers();
     }
-    return std::vector<std::string>();
+    return std::vector<PlayerId>();
 }
 
 int RoomManager::getRoomPlayerCount(int roomId) const {
@@ -208,10 +226,72 @@ int RoomManager::getRoomPlayerCount(int roomId) const {
     return 0;
 }
 
-bool RoomManager::isPlayerInRoom(int roomId, const std::string& username) const {
+bool RoomManager::isPlayerInRoom(int roomId, PlayerId player) const {
     auto it = rooms.find(roomId);
     if (it != rooms.end()) {
-        return it->second.hasPlayer(username);
+        return it->second.hasPlayer(player);
     }
     return false;
-} 
\ No newline at end of file
+} 
+bool RoomManager::saveRoom(int roomId, SnapshotEncoder& out) const {
+    auto it = rooms.find(roomId);
+    if (it == rooms.end()) {
+        return false;
+    }
+    const Room& room = it->second;
+    out.addString(room.roomName).addString(players.nameOf(room.hostId))
+       .addU8(static_cast<uint8_t>(room.kind)).addI32(room.capacity)
+       .addU8(static_cast<uint8_t>(room.gameState)).addI32(room.currentQuestionIndex).addI32(room.totalQuestions);
+    out.addU32(static_cast<uint32_t>(room.players.size()));
+    for (PlayerId player : room.players) {
+        out.addString(players.nameOf(player));
+    }
+    return true;
+}
+
+// Players already placed in another restored room are left out of this one
+bool RoomManager::restoreRoom(int roomId, SnapshotDecoder& in, PlayerDirectory& directory) {
+    std::string roomName, hostName;
+    uint8_t kind = 0, gameState = 0;
+    int32_t capacity = 0, currentQuestionIndex = 0, totalQuestions = 0;
+    uint32_t playerCount = 0;
+    in.readString(roomName);
+    in.readString(hostName);
+    in.readU8(kind);
+    in.readI32(capacity);
+    in.readU8(gameState);
+    in.readI32(currentQuestionIndex);
+    in.readI32(totalQuestions);
+    in.readCount(playerCount, 4);
+    if (!in.ok() || roomId < 1 || rooms.find(roomId) != rooms.end()
+        || kind > static_cast<uint8_t>(RoomKind::ARENA) || gameState > static_cast<uint8_t>(GameState::FINISHED)) {
+        return false;
+    }
+    Room room(roomId, roomName, directory.intern(hostName), static_cast<RoomKind>(kind), capacity);
+    room.setGameState(static_cast<GameState>(gameState));
+    room.setCurrentQuestionIndex(currentQuestionIndex);
+    room.setTotalQuestions(totalQuestions);
+    for (uint32_t i = 0; i < playerCount; ++i) {
+        std::string name;
+        if (!in.readString(name)) {
+            return false;
+        }
+        PlayerId player = directory.intern(name);
+        if (!room.hasPlayer(player)) {
+            room.addPlayer(player);
+        }
+    }
+    // Players who are in another room by now are left out
+    std::vector<PlayerId> restoredPlayers = room.players;
+    for (PlayerId player : restoredPlayers) {
+        if (!players.claimRoom(player, roomId)) {
+            room.removePlayer(player);
+        }
+    }
+    rooms[roomId] = std::move(room);
+    // New rooms must not reuse a restored id
+    while (nextRoomId <= roomId) {
+        nextRoomId += roomIdStride;
+    }
+    return true;
+}
@@ -3,9 +3,12 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include "../common/room.h"
 #include "../common/user.h"
+#include "player_directory.h"
+#include "game_snapshot.h"
 
 enum class JoinRoomResult {
     SUCCESS,
@@ -19,38 +22,53 @@ enum class JoinRoomResult {
 class RoomManager {
 private:
     std::map<int, Room> rooms;  
+    PlayerDirectory& players;   // also records each player's room, across all shards
+    int firstRoomId;
+    int roomIdStride;   // shards allocate interleaved ids: first, first + stride, ...
     int nextRoomId; 
+    int arenaCapacity;
 
 public:
-    RoomManager();
+    RoomManager(PlayerDirectory& directory, int firstId = 1, int idStride = 1);
     ~RoomManager();
 
     // Room creation and management
-    int createRoom(const std::string& roomName, const std::string& hostUsername);
-    JoinRoomResult joinRoom(int roomId, const std::string& username);
-    bool leaveRoom(int roomId, const std::string& username);
+    int createRoom(const std::string& roomName, PlayerId host, RoomKind kind = RoomKind::STANDARD);
+    JoinRoomResult joinRoom(int roomId, PlayerId player);
+    bool leaveRoom(int roomId, PlayerId player);
     bool deleteRoom(int roomId);
     
     Room* getRoom(int roomId);
     std::vector<Room> getAllRooms() const;
-    std::vector<Room> getAvailableRooms() const;  // Rooms that are waiting for players
+    std::vector<const Room*> getAvailableRooms() const;  // Rooms that are waiting for players
     bool roomExists(int roomId) const;
-    bool isUserInRoom(const std::string& username) const;
-    int getUserRoomId(const std::string& username) const;
+    // Whether the player is in a room on any shard
+    bool isUserInRoom(PlayerId player) const;
+    int getUserRoomId(PlayerId player) const;
     
-    bool startGame(int roomId, const std::string& hostUsername);
+    bool startGame(int roomId, PlayerId host);
     bool endGame(int roomId);
     bool isGameInProgress(int roomId) const;
     
     // Player management
-    std::vector<std::string> getRoomPlayers(int roomId) const;
+    std::vector<PlayerId> getRoomPlayers(int roomId) const;
     int getRoomPlayerCount(int roomId) const;
-    bool isPlayerInRoom(int roomId, const std::string& username) const;
+    bool isPlayerInRoom(int roomId, PlayerId player) const;
     
+    // Snapshot support: appends the room to a record, false if there is no
+    // such room; restoreRoom reads it back under the same id
+    bool saveRoom(int roomId, SnapshotEncoder& out) const;
+    bool restoreRoom(int roomId, SnapshotDecoder& in, PlayerDirectory& directory);
+
     int getRoomCount() const { return static_cast<int>(rooms.size()); }
-    void clearRooms() { rooms.clear(); nextRoomId = 1; }
+    void setArenaCapacity(int capacity) { arenaCapacity = capacity; }
+    void clearRooms();
     
-    int generateRoomId() { return nextRoomId++; }
+    int generateRoomId() {
+        int roomId = nextRoomId;
+        nextRoomId += roomIdStride;
+        return roomId;
+    }
 };
 
 #endif 
\ No newline at end of file
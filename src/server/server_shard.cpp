@@ -0,0 +1,1162 @@
+#include "server_shard.h"
+#include <iostream>
+#include <algorithm>
+#include <tuple>
+#include "debug_log.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+namespace {
+    std::atomic<uint64_t> nextConnectionId{1};
+
+    // Most time a snapshot tick may spend encoding rooms; what is left over
+    // is encoded on the next wheel tick
+    const std::chrono::microseconds SNAPSHOT_SLICE(1000);
+    const std::chrono::milliseconds SNAPSHOT_CONTINUE_DELAY(10);
+}
+
+ServerShard::ServerShard(int idx, int count, ReactorBackend backend,
+                         AuthenticationManager& am, QuestionManager& qm, WorkerPool& workers,
+                         SessionDirectory& sessions)
+    : index(idx), shardCount(count), reactor(createReactor(backend)), wakeupFd(-1),
+      listenSocket(-1), nextAcceptShard(0), running(false),
+      authManager(am), questionManager(qm), authWorkers(workers), sessionDirectory(sessions),
+      roomManager(am.getPlayerDirectory(), idx + 1, count),
+      gameEngine(roomManager, questionManager, am.getPlayerDirectory()),
+      resumeGraceSeconds(GameConstants::DEFAULT_RESUME_GRACE_SECONDS), nextBrowseId(1),
+      snapshotStore(nullptr), snapshotInterval(GameConstants::DEFAULT_SNAPSHOT_INTERVAL_MS), sessionsDirty(false),
+      responsePrefix(std::make_shared<const std::string>("GAME_RESPONSE|")) {
+}
+
+ServerShard::~ServerShard() {
+    for (auto& pair : clients) {
+        close(pair.first);
+    }
+    if (wakeupFd != -1) {
+        close(wakeupFd);
+    }
+}
+
+bool ServerShard::init() {
+    wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeupFd == -1) {
+        std::cerr << "Shard " << index << ": eventfd failed with error: " << errno << std::endl;
+        return false;
+    }
+    return reactor->add(wakeupFd, EVENT_READ);
+}
+
+void ServerShard::setPeers(const std::vector<ServerShard*>& shards) {
+    peers = shards;
+}
+
+bool ServerShard::setListener(int socket) {
+    listenSocket = socket;
+    return reactor->add(listenSocket, EVENT_READ);
+}
+
+void ServerShard::post(Task task) {
+    bool wasEmpty;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        wasEmpty = mailbox.empty();
+        mailbox.push_back(std::move(task));
+    }
+    if (wasEmpty) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeupFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void ServerShard::stop() {
+    running = false;
+    post([](ServerShard&) {});
+}
+
+void ServerShard::drainMailbox() {
+    uint64_t count;
+    while (read(wakeupFd, &count, sizeof(count)) > 0) {
+    }
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mailboxMutex);
+        tasks.swap(mailbox);
+    }
+    for (auto& task : tasks) {
+        task(*this);
+    }
+}
+
+void ServerShard::run() {
+    running = true;
+    std::cout << "Shard " << index << " running (" << reactor->name() << " reactor)..." << std::endl;
+
+    std::vector<ReactorEvent> ready;
+    while (running) {
+        // Sleep until the next timer is due, or indefinitely if none is pending
+        int timeoutMs = timers.millisecondsUntilNext(std::chrono::steady_clock::now());
+        int activity = reactor->wait(ready, timeoutMs);
+        if (activity == -1) {
+            std::cerr << "Shard " << index << ": reactor wait failed with error: " << errno << std::endl;
+            break;
+        }
+        timers.advance(std::chrono::steady_clock::now());
+
+        for (const ReactorEvent& event : ready) {
+            if (event.fd == listenSocket) {
+                acceptClients();
+            } else if (event.fd == wakeupFd) {
+                drainMailbox();
+            } else {
+                serviceClient(event.fd, event.events);
+            }
+        }
+        closePendingClients();
+    }
+    running = false;
+
+    std::cout << "Shard " << index << " output: " << outputStats.bytesQueued << " bytes queued, "
+              << outputStats.bytesSent << " sent, " << outputStats.bytesDropped << " dropped, "
+              << outputStats.slowConsumersDropped << " slow clients dropped." << std::endl;
+}
+
+int ServerShard::ownerOf(int roomId) const {
+    if (roomId < 1) {
+        return index;
+    }
+    return (roomId - 1) % shardCount;
+}
+
+// Accept every pending connection and spread them round-robin over the shards
+void ServerShard::acceptClients() {
+    while (true) {
+        int clientSocket = accept(listenSocket, NULL, NULL);
+        if (clientSocket == -1) {
+            if (errno == EINTR) continue;
+            if (errno != EWOULDBLOCK && errno != EAGAIN) {
+                std::cerr << "Accept failed with error: " << errno << std::endl;
+            }
+            return;
+        }
+        int clientFlags = fcntl(clientSocket, F_GETFL, 0);
+        fcntl(clientSocket, F_SETFL, clientFlags | O_NONBLOCK);
+
+        int target = nextAcceptShard;
+        nextAcceptShard = (nextAcceptShard + 1) % shardCount;
+        if (target == index) {
+            adoptConnection(clientSocket);
+        } else {
+            peers[target]->post([clientSocket](ServerShard& shard) { shard.adoptConnection(clientSocket); });
+        }
+    }
+}
+
+void ServerShard::adoptConnection(int clientSocket) {
+    if (!reactor->add(clientSocket, EVENT_READ)) {
+        std::cerr << "Could not watch client socket " << clientSocket << ", closing it." << std::endl;
+        close(clientSocket);
+        return;
+    }
+    clients.emplace(clientSocket, ClientSession(clientSocket, nextConnectionId++));
+
+    std::cout << "Client connected. Socket: " << clientSocket << " Shard: " << index
+              << " Shard clients: " << clients.size() << std::endl;
+}
+
+// Take over a session handed off by another shard and replay the command that moved it
+void ServerShard::adoptClient(ClientSession session) {
+    int clientSocket = session.socket;
+    if (!reactor->add(clientSocket, EVENT_READ)) {
+        std::cerr << "Could not watch migrated socket " << clientSocket << ", closing it." << std::endl;
+        if (!session.resumeToken.empty()) {
+            sessionDirectory.revoke(session.resumeToken);
+        }
+        if (session.currentRoomId != -1) {
+            gameEngine.removePlayer(session.currentRoomId, session.playerId);
+        }
+        close(clientSocket);
+        return;
+    }
+    auto it = clients.emplace(clientSocket, std::move(session)).first;
+    bindPlayer(it->second);
+    if (!it->second.resumeToken.empty()) {
+        socketsByToken[it->second.resumeToken] = clientSocket;
+        sessionDirectory.move(it->second.resumeToken, index);
+    }
+    DEBUG_LOG(LogLevel::DEBUG, "Shard " + std::to_string(index) + " adopted client " + std::to_string(clientSocket) + " (" + it->second.username + ")");
+    if (!it->second.output.empty()) {
+        flushClient(it->second);
+    }
+
+    std::string msg;
+    msg.swap(it->second.pendingMessage);
+    if (!msg.empty() && !handleMessage(it->second, msg)) {
+        removeClient(clientSocket);
+        return;
+    }
+    serviceClient(clientSocket);
+}
+
+void ServerShard::migrateClient(int clientSocket) {
+    auto it = clients.find(clientSocket);
+    if (it == clients.end()) {
+        return;
+    }
+    int target = it->second.migrateTo;
+    it->second.migrateTo = -1;
+    it->second.writeWatched = false;
+    unbindPlayer(it->second);
+    socketsByToken.erase(it->second.resumeToken);
+    reactor->remove(clientSocket);
+    auto moved = std::make_shared<ClientSession>(std::move(it->second));
+    clients.erase(it);
+    DEBUG_LOG(LogLevel::DEBUG, "Shard " + std::to_string(index) + " handing client " + std::to_string(clientSocket) + " to shard " + std::to_string(target));
+    peers[target]->post([moved](ServerShard& shard) { shard.adoptClient(std::move(*moved)); });
+}
+
+void ServerShard::removeClient(int clientSocket) {
+    auto it = clients.find(clientSocket);
+    if (it == clients.end()) {
+        return;
+    }
+    ClientSession& session = it->second;
+    markRoomDirty(session.currentRoomId);
+    markSessionsDirty(session.currentRoomId);
+    if (!session.resumeToken.empty() && resumeGraceSeconds > 0) {
+        // Keep the player's place in the game for a while so the client can RESUME
+        parkSession(session.resumeToken, session.username, session.playerId, session.currentRoomId);
+    } else {
+        revokeResumeToken(session);
+        if (session.currentRoomId != -1) {
+            gameEngine.removePlayer(session.currentRoomId, session.playerId);
+        }
+    }
+    outputStats.bytesDropped += session.output.clear();
+    unbindPlayer(session);
+
+    reactor->remove(clientSocket);
+    close(clientSocket);
+    clients.erase(it);
+
+    std::cout << "Client " << clientSocket << " removed. Shard " << index << " clients: " << clients.size() << std::endl;
+}
+
+// The most recent login of a player receives its messages
+void ServerShard::bindPlayer(ClientSession& session) {
+    if (session.authenticated) {
+        socketsByPlayer[session.playerId] = session.socket;
+    }
+}
+
+void ServerShard::unbindPlayer(const ClientSession& session) {
+    if (!session.authenticated) {
+        return;
+    }
+    auto it = socketsByPlayer.find(session.playerId);
+    if (it != socketsByPlayer.end() && it->second == session.socket) {
+        socketsByPlayer.erase(it);
+    }
+}
+
+void ServerShard::revokeResumeToken(ClientSession& session) {
+    if (session.resumeToken.empty()) {
+        return;
+    }
+    sessionDirectory.revoke(session.resumeToken);
+    auto it = socketsByToken.find(session.resumeToken);
+    if (it != socketsByToken.end() && it->second == session.socket) {
+        socketsByToken.erase(it);
+    }
+    session.resumeToken.clear();
+}
+
+void ServerShard::parkSession(const std::string& token, const std::string& username, PlayerId playerId, int roomId) {
+    socketsByToken.erase(token);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(resumeGraceSeconds);
+    TimerId expiry = timers.schedule(deadline, [this, token]() { expireParkedSession(token); });
+    parkedSessions[token] = ParkedSession{username, playerId, roomId, expiry};
+    DEBUG_LOG(LogLevel::INFO, "Parked session of " + username + " for " + std::to_string(resumeGraceSeconds) + "s");
+}
+
+void ServerShard::expireParkedSession(const std::string& token) {
+    auto it = parkedSessions.find(token);
+    if (it == parkedSessions.end()) {
+        return;
+    }
+    const ParkedSession& parked = it->second;
+    markRoomDirty(parked.roomId);
+    markSessionsDirty(parked.roomId);
+    // The player may have logged in again and rejoined the room meanwhile
+    if (parked.roomId != -1 && socketsByPlayer.find(parked.playerId) == socketsByPlayer.end()) {
+        gameEngine.removePlayer(parked.roomId, parked.playerId);
+    }
+    sessionDirectory.revoke(token);
+    parkedSessions.erase(it);
+}
+
+// Mark a session for removal at the end of the current event batch. Used
+// where the session may still be referenced further up the stack.
+void ServerShard::scheduleClose(ClientSession& session) {
+    if (session.closing) {
+        return;
+    }
+    session.closing = true;
+    outputStats.bytesDropped += session.output.clear();
+    closeQueue.emplace_back(session.socket, session.connectionId);
+}
+
+void ServerShard::closePendingClients() {
+    while (!closeQueue.empty()) {
+        std::vector<std::pair<int, uint64_t>> batch;
+        batch.swap(closeQueue);
+        for (const auto& [clientSocket, connectionId] : batch) {
+            auto it = clients.find(clientSocket);
+            if (it != clients.end() && it->second.connectionId == connectionId) {
+                removeClient(clientSocket);
+            }
+        }
+    }
+}
+
+void ServerShard::serviceClient(int clientSocket, unsigned events) {
+    auto it = clients.find(clientSocket);
+    if (it == clients.end()) {
+        return;
+    }
+    if (events & EVENT_WRITE) {
+        flushClient(it->second);
+    }
+    if (!(events & (EVENT_READ | EVENT_HANGUP | EVENT_ERROR))) {
+        return;
+    }
+    ClientStatus status = readFromClient(it->second);
+    if (status == ClientStatus::CLOSED) {
+        removeClient(clientSocket);
+    } else if (status == ClientStatus::MIGRATED) {
+        migrateClient(clientSocket);
+    }
+}
+
+// Run every buffered frame, then read more until the socket would block.
+// Frames are left buffered while the session waits on another shard and
+// picked up again once it is answered.
+ServerShard::ClientStatus ServerShard::readFromClient(ClientSession& session) {
+    int clientSocket = session.socket;
+    while (!session.closing) {
+        std::string_view frame;
+        while (!session.awaitingReply && session.input.nextFrame(frame)) {
+            if (!handleMessage(session, frame)) {
+                return ClientStatus::CLOSED;
+            }
+            if (session.migrateTo != -1) {
+                return ClientStatus::MIGRATED;
+            }
+        }
+        if (session.awaitingReply) {
+            return ClientStatus::OPEN;
+        }
+        if (session.input.overflowed()) {
+            std::cerr << "Client " << clientSocket << " sent a message longer than "
+                      << GameConstants::MAX_MESSAGE_LENGTH << " bytes." << std::endl;
+            reply(session, "ERROR", {"Message too long"});
+            return ClientStatus::CLOSED;
+        }
+
+        InputBuffer::ReadResult result = session.input.readFrom(clientSocket);
+        if (result == InputBuffer::ReadResult::WOULD_BLOCK) {
+            return ClientStatus::OPEN;
+        }
+        if (result == InputBuffer::ReadResult::CLOSED) {
+            std::cout << "Client " << clientSocket << " (" << session.username << ") disconnected." << std::endl;
+            return ClientStatus::CLOSED;
+        }
+        if (result == InputBuffer::ReadResult::ERROR) {
+            std::cerr << "Receive error for client " << clientSocket << ": " << errno << std::endl;
+            return ClientStatus::CLOSED;
+        }
+    }
+    return ClientStatus::CLOSED;
+}
+
+// Parse and run one command in place over the receive buffer.
+// Returns false once the session is being closed.
+bool ServerShard::handleMessage(ClientSession& session, std::string_view msg) {
+    ProtocolMessageView parsed = parseMessageView(msg);
+    DEBUG_LOG(LogLevel::DEBUG, "Received from client " + std::to_string(session.socket) + " (" + session.username + "): '" + std::string(msg) + "' Parsed command: '" + std::string(parsed.command) + "'");
+
+    processCommand(parsed, session);
+    return !session.closing;
+}
+
+std::vector<std::pair<int, std::string>> ServerShard::listAvailableRooms() const {
+    std::vector<std::pair<int, std::string>> result;
+    for (const Room* room : roomManager.getAvailableRooms()) {
+        result.emplace_back(room->getRoomId(), room->getRoomName());
+    }
+    return result;
+}
+
+void ServerShard::completeBrowse(uint64_t browseId, const std::vector<std::pair<int, std::string>>& rooms) {
+    auto it = pendingBrowses.find(browseId);
+    if (it == pendingBrowses.end()) {
+        return;
+    }
+    PendingBrowse& browse = it->second;
+    browse.rooms.insert(browse.rooms.end(), rooms.begin(), rooms.end());
+    if (--browse.remainingShards > 0) {
+        return;
+    }
+
+    std::sort(browse.rooms.begin(), browse.rooms.end());
+    int clientSocket = browse.socket;
+    uint64_t connectionId = browse.connectionId;
+
+    auto clientIt = clients.find(clientSocket);
+    if (clientIt == clients.end() || clientIt->second.connectionId != connectionId) {
+        pendingBrowses.erase(it);
+        return;
+    }
+    ClientSession& session = clientIt->second;
+    session.awaitingReply = false;
+
+    replyRoomList(session, browse.rooms);
+    pendingBrowses.erase(it);
+    serviceClient(clientSocket);
+}
+
+// Build a reply frame in place at the tail of the client's output queue
+void ServerShard::reply(ClientSession& session, std::string_view command, std::initializer_list<std::string_view> params) {
+    if (session.closing) {
+        return;
+    }
+    bool wasEmpty = session.output.empty();
+    std::string& out = session.output.beginAppend();
+    MessageAppender message(out, command);
+    for (std::string_view param : params) {
+        message.add(param);
+    }
+    out.push_back('\n');
+    outputStats.bytesQueued += session.output.endAppend();
+    commitOutput(session, wasEmpty);
+}
+
+void ServerShard::replyRoomList(ClientSession& session, const std::vector<std::pair<int, std::string>>& rooms) {
+    if (session.closing) {
+        return;
+    }
+    bool wasEmpty = session.output.empty();
+    std::string& out = session.output.beginAppend();
+    MessageAppender message(out, "ROOM_LIST");
+    for (const auto& room : rooms) {
+        message.add(room.first).add(room.second);
+    }
+    out.push_back('\n');
+    outputStats.bytesQueued += session.output.endAppend();
+    commitOutput(session, wasEmpty);
+}
+
+// Queue one protocol line for a client and try to write it straight away
+void ServerShard::queueToClient(ClientSession& session, std::string_view message) {
+    if (session.closing) {
+        return;
+    }
+    bool wasEmpty = session.output.empty();
+    std::string& out = session.output.beginAppend();
+    out.append(message.data(), message.size());
+    out.push_back('\n');
+    outputStats.bytesQueued += session.output.endAppend();
+    commitOutput(session, wasEmpty);
+}
+
+// Queue a complete, newline-terminated frame that is shared by several recipients
+void ServerShard::queueSharedToClient(ClientSession& session, const std::shared_ptr<const std::string>& frame) {
+    if (session.closing) {
+        return;
+    }
+    bool wasEmpty = session.output.empty();
+    session.output.appendShared(frame);
+    outputStats.bytesQueued += frame->size();
+    commitOutput(session, wasEmpty);
+}
+
+// Write newly queued output straight away unless a flush is already waiting
+// on writability. Clients that let too much output pile up are disconnected.
+void ServerShard::commitOutput(ClientSession& session, bool wasEmpty) {
+    if (session.output.size() > static_cast<size_t>(GameConstants::MAX_OUTPUT_QUEUE_BYTES)) {
+        ++outputStats.slowConsumersDropped;
+        std::cerr << "Client " << session.socket << " (" << session.username << ") is not reading; dropping it with "
+                  << session.output.size() << " bytes queued." << std::endl;
+        scheduleClose(session);
+        return;
+    }
+    if (wasEmpty) {
+        flushClient(session);
+    }
+}
+
+// Write as much queued output as the socket takes; watch for writability while any is left
+void ServerShard::flushClient(ClientSession& session) {
+    if (session.closing) {
+        return;
+    }
+    OutputQueue::FlushResult result = session.output.flush(session.socket, outputStats);
+    if (result == OutputQueue::FlushResult::ERROR) {
+        std::cerr << "Send failed for client " << session.socket << ": " << errno << std::endl;
+        scheduleClose(session);
+        return;
+    }
+    bool wantWrite = (result == OutputQueue::FlushResult::PENDING);
+    if (wantWrite != session.writeWatched) {
+        session.writeWatched = wantWrite;
+        reactor->modify(session.socket, wantWrite ? (EVENT_READ | EVENT_WRITE) : EVENT_READ);
+    }
+}
+
+// Helper: send a message to a logged-in player
+void ServerShard::sendToClient(PlayerId player, const std::string& message) {
+    DEBUG_LOG(LogLevel::DEBUG, "Sending to " + authManager.getPlayerDirectory().nameOf(player) + ": '" + message + "' (with newline)");
+    if (debugLogEnabled(LogLevel::TRACE)) {
+        debugLogHexDump("Raw bytes: ", message + "\n");
+    }
+    auto it = socketsByPlayer.find(player);
+    if (it == socketsByPlayer.end()) {
+        return;
+    }
+    auto clientIt = clients.find(it->second);
+    if (clientIt != clients.end()) {
+        queueToClient(clientIt->second, message);
+    }
+}
+
+// Helper: broadcast a message to all players in a room. The frame is
+// serialized once and shared by every recipient's output queue.
+void ServerShard::broadcastToRoom(int roomId, const std::vector<PlayerId>& players, const std::string& message) {
+    DEBUG_LOG(LogLevel::DEBUG, "Broadcasting to room " + std::to_string(roomId) + " (" + std::to_string(players.size()) + " players): '" + message + "'");
+    broadcastSegments(players, {std::make_shared<const std::string>(message + "\n")});
+}
+
+// Queue a frame made of shared segments for every player, then write. The
+// whole room is queued before anything is written, so in a large room the
+// first recipients' writes do not delay the last ones' queueing.
+void ServerShard::broadcastSegments(const std::vector<PlayerId>& players,
+                                    std::initializer_list<std::shared_ptr<const std::string>> segments) {
+    size_t frameSize = 0;
+    for (const auto& segment : segments) {
+        frameSize += segment->size();
+    }
+    broadcastBatch.clear();
+    broadcastBatch.reserve(players.size());
+    for (PlayerId player : players) {
+        auto it = socketsByPlayer.find(player);
+        if (it == socketsByPlayer.end()) {
+            continue;
+        }
+        auto clientIt = clients.find(it->second);
+        if (clientIt == clients.end() || clientIt->second.closing) {
+            continue;
+        }
+        ClientSession& session = clientIt->second;
+        broadcastBatch.emplace_back(&session, session.output.empty());
+        for (const auto& segment : segments) {
+            session.output.appendShared(segment);
+        }
+        outputStats.bytesQueued += frameSize;
+    }
+    for (const auto& recipient : broadcastBatch) {
+        commitOutput(*recipient.first, recipient.second);
+    }
+    broadcastBatch.clear();
+}
+
+// Send a QUESTION reply: only the prefix and the seconds left are written
+// into the queue, the rest is spliced in from the shared segments
+void ServerShard::queueQuestion(ClientSession& session, const QuestionFrame& frame) {
+    if (session.closing) {
+        return;
+    }
+    DEBUG_LOG(LogLevel::DEBUG, "Sending " + *frame.position + " to " + session.username);
+    bool wasEmpty = session.output.empty();
+    const Question& question = *frame.question;
+    session.output.beginAppend().append("GAME_RESPONSE|");
+    size_t queued = session.output.endAppend();
+    session.output.appendShared(frame.position);
+    session.output.appendShared(question.textSegment);
+    session.output.beginAppend().append(std::to_string(frame.secondsLeft));
+    queued += session.output.endAppend();
+    session.output.appendShared(question.optionsSegment);
+    outputStats.bytesQueued += queued + frame.position->size() + question.textSegment->size()
+                               + question.optionsSegment->size();
+    commitOutput(session, wasEmpty);
+}
+
+// Arm the end-of-game timer for the game that just started in the room
+void ServerShard::scheduleGameTimer(int roomId) {
+    std::chrono::steady_clock::time_point deadline;
+    if (!gameEngine.getGameDeadline(roomId, deadline)) {
+        return;
+    }
+    cancelGameTimer(roomId);
+    gameTimers[roomId] = timers.schedule(deadline, [this, roomId]() {
+        gameTimers.erase(roomId);
+        finishExpiredGame(roomId);
+    });
+}
+
+void ServerShard::cancelGameTimer(int roomId) {
+    auto it = gameTimers.find(roomId);
+    if (it != gameTimers.end()) {
+        timers.cancel(it->second);
+        gameTimers.erase(it);
+    }
+}
+
+// The game ran out of time: finish it and push the final standings to every player at once
+void ServerShard::finishExpiredGame(int roomId) {
+    std::string leaderboard = gameEngine.expireGame(roomId);
+    if (leaderboard.empty()) {
+        return;
+    }
+    markRoomDirty(roomId);
+    std::cout << "Game in room " << roomId << " finished: time is up." << std::endl;
+    broadcastToRoom(roomId, gameEngine.getActivePlayers(roomId),
+                    buildMessage("GAME_RESPONSE", {"GAME_FINISHED|" + leaderboard}));
+}
+
+void ServerShard::enableQuestionDeadlines() {
+    gameEngine.setQuestionDeadlines(true);
+}
+
+void ServerShard::setArenaCapacity(int capacity) {
+    roomManager.setArenaCapacity(capacity);
+}
+
+void ServerShard::setResumeGrace(int seconds) {
+    resumeGraceSeconds = seconds;
+}
+
+void ServerShard::enableSnapshots(GameSnapshotStore& store, int intervalMs) {
+    snapshotStore = &store;
+    snapshotInterval = std::chrono::milliseconds(intervalMs);
+    scheduleSnapshot(snapshotInterval);
+}
+
+void ServerShard::markRoomDirty(int roomId) {
+    if (snapshotStore && roomId != -1) {
+        dirtyRooms.insert(roomId);
+    }
+}
+
+// Only sessions in a room are saved; roomId is the room the change concerns
+void ServerShard::markSessionsDirty(int roomId) {
+    if (snapshotStore && roomId != -1) {
+        sessionsDirty = true;
+    }
+}
+
+void ServerShard::scheduleSnapshot(std::chrono::milliseconds delay) {
+    timers.schedule(std::chrono::steady_clock::now() + delay, [this]() {
+        bool done = encodeDirtyRooms(std::chrono::steady_clock::now() + SNAPSHOT_SLICE);
+        scheduleSnapshot(done ? snapshotInterval : SNAPSHOT_CONTINUE_DELAY);
+    });
+}
+
+void ServerShard::saveSnapshot() {
+    if (snapshotStore) {
+        encodeDirtyRooms(std::chrono::steady_clock::time_point::max());
+    }
+}
+
+// Re-encode the session record if it changed, then changed rooms until
+// the deadline, and hand the records to the store, which writes them from
+// its own thread. A room that is gone is dropped from the store. Returns
+// false if rooms are left for later.
+bool ServerShard::encodeDirtyRooms(std::chrono::steady_clock::time_point deadline) {
+    if (sessionsDirty) {
+        encodeSessions();
+    }
+    if (dirtyRooms.empty()) {
+        return true;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::pair<int, GameSnapshotStore::Record>> changes;
+    auto it = dirtyRooms.begin();
+    while (it != dirtyRooms.end() && std::chrono::steady_clock::now() < deadline) {
+        int roomId = *it;
+        auto record = std::make_shared<std::string>();
+        SnapshotEncoder out(*record);
+        if (roomManager.saveRoom(roomId, out)) {
+            gameEngine.saveGame(roomId, out);
+            changes.emplace_back(roomId, std::move(record));
+        } else {
+            changes.emplace_back(roomId, nullptr);
+        }
+        it = dirtyRooms.erase(it);
+    }
+    size_t encoded = changes.size();
+    snapshotStore->update(changes);
+    DEBUG_LOG(LogLevel::DEBUG, "Shard " + std::to_string(index) + " snapshot: " + std::to_string(encoded) + " room(s) in "
+              + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count())
+              + " us, " + std::to_string(dirtyRooms.size()) + " left");
+    return dirtyRooms.empty();
+}
+
+// Resume tokens of the sessions in this shard's rooms, connected or
+// parked, so their players can RESUME after a restart. Sessions outside a
+// room have nothing to lose and are left out.
+void ServerShard::encodeSessions() {
+    sessionsDirty = false;
+    auto saved = [](const ClientSession& session) {
+        return !session.resumeToken.empty() && session.currentRoomId != -1 && !session.closing;
+    };
+    uint32_t count = 0;
+    for (const auto& client : clients) {
+        count += saved(client.second);
+    }
+    for (const auto& parked : parkedSessions) {
+        count += parked.second.roomId != -1;
+    }
+    auto record = std::make_shared<std::string>();
+    SnapshotEncoder out(*record);
+    out.addU32(count);
+    for (const auto& client : clients) {
+        const ClientSession& session = client.second;
+        if (saved(session)) {
+            out.addString(session.resumeToken).addString(session.username).addI32(session.currentRoomId);
+        }
+    }
+    for (const auto& [token, parked] : parkedSessions) {
+        if (parked.roomId != -1) {
+            out.addString(token).addString(parked.username).addI32(parked.roomId);
+        }
+    }
+    snapshotStore->updateSessions(index, std::move(record));
+}
+
+bool ServerShard::restoreRoom(int roomId, const std::string& record) {
+    PlayerDirectory& directory = authManager.getPlayerDirectory();
+    SnapshotDecoder in(record);
+    if (!roomManager.restoreRoom(roomId, in, directory)) {
+        std::cerr << "Could not restore room " << roomId << " from the snapshot." << std::endl;
+        return false;
+    }
+    if (!gameEngine.restoreGame(roomId, in, directory) || !in.atEnd()) {
+        std::cerr << "Could not restore the game in room " << roomId << " from the snapshot." << std::endl;
+        gameEngine.cleanupRoom(roomId);
+        roomManager.deleteRoom(roomId);
+        return false;
+    }
+    scheduleGameTimer(roomId);
+    for (PlayerId player : gameEngine.getActivePlayers(roomId)) {
+        scheduleQuestionTimer(roomId, player);
+    }
+    // Written again under this run's store
+    markRoomDirty(roomId);
+    return true;
+}
+
+// Sessions come back parked: their players have the usual grace window to
+// RESUME with the token they held before the restart. Every shard reads
+// every record and takes the sessions whose room it owns.
+void ServerShard::restoreSessions(const std::string& record) {
+    PlayerDirectory& directory = authManager.getPlayerDirectory();
+    SnapshotDecoder in(record);
+    uint32_t count = 0;
+    in.readCount(count, 12);
+    std::vector<std::tuple<std::string, std::string, int32_t>> sessions(count);
+    for (auto& [token, username, roomId] : sessions) {
+        in.readString(token);
+        in.readString(username);
+        in.readI32(roomId);
+    }
+    if (!in.ok() || !in.atEnd()) {
+        std::cerr << "Could not restore sessions from the snapshot." << std::endl;
+        return;
+    }
+    for (const auto& [token, username, roomId] : sessions) {
+        if (ownerOf(roomId) != index || token.empty()) {
+            continue;
+        }
+        PlayerId player = directory.intern(username);
+        Room* room = roomManager.getRoom(roomId);
+        if (!room || !room->hasPlayer(player)) {
+            continue;
+        }
+        sessionDirectory.restore(token, index);
+        parkSession(token, username, player, roomId);
+        sessionsDirty = true;
+    }
+}
+
+// Time out the question the player was just shown if it is not answered in time
+void ServerShard::scheduleQuestionTimer(int roomId, PlayerId player) {
+    QuestionDeadline deadline;
+    if (!gameEngine.getQuestionDeadline(roomId, player, deadline)) {
+        return;
+    }
+    auto it = questionTimers.find(player);
+    if (it != questionTimers.end()) {
+        timers.cancel(it->second);
+    }
+    questionTimers[player] = timers.schedule(deadline.deadline, [this, roomId, player, deadline]() {
+        questionTimers.erase(player);
+        std::string result = gameEngine.expireQuestion(roomId, player, deadline);
+        if (!result.empty()) {
+            markRoomDirty(roomId);
+            sendToClient(player, buildMessage("GAME_RESPONSE", {result}));
+        }
+    });
+}
+
+// Command registry, indexed by CommandId. Preconditions are checked once
+// by processCommand before the handler runs.
+const ServerShard::CommandHandler ServerShard::commandHandlers[] = {
+    // handler                               auth   room   params  error when params are missing      changes room
+    {&ServerShard::handleRegister,           false, false, 2, "Invalid registration parameters",  false},
+    {&ServerShard::handleLogin,              false, false, 2, "Invalid login parameters",         false},
+    {&ServerShard::handleCreateRoom,         true,  false, 2, "Invalid room creation parameters", true},
+    {&ServerShard::handleJoinRoom,           true,  false, 2, "Invalid join room parameters",     true},
+    {&ServerShard::handleBrowseRooms,        false, false, 0, "",                                 false},
+    {&ServerShard::handleStartGame,          true,  true,  2, "Invalid start game parameters",    true},
+    {&ServerShard::handleEndGame,            true,  true,  0, "",                                 true},
+    {&ServerShard::handleGetCurrentQuestion, true,  true,  0, "",                                 true},
+    {&ServerShard::handleSubmitAnswer,       true,  true,  3, "Invalid submit answer parameters", true},
+    {&ServerShard::handleGetGameInfo,        true,  true,  0, "",                                 false},
+    {&ServerShard::handleGetLeaderboard,     true,  true,  0, "",                                 false},
+    {&ServerShard::handleQuit,               false, false, 0, "",                                 false},
+    {&ServerShard::handleResume,             false, false, 1, "Invalid resume parameters",        true}
+};
+
+// Dispatch one command; replies are written straight into the session's output queue
+void ServerShard::processCommand(const ProtocolMessageView& parsed, ClientSession& session) {
+    static_assert(sizeof(commandHandlers) / sizeof(commandHandlers[0]) == CommandTable::COMMAND_COUNT,
+                  "Every CommandId needs a handler");
+    CommandId id = CommandTable::lookup(parsed.command);
+    if (id == CommandId::UNKNOWN) {
+        reply(session, "ERROR", {"Unknown command"});
+        return;
+    }
+    const CommandHandler& command = commandHandlers[static_cast<size_t>(id)];
+    if (command.requiresAuth && !session.authenticated) {
+        reply(session, "ERROR", {"Not authenticated"});
+    } else if (command.requiresRoom && session.currentRoomId == -1) {
+        reply(session, "ERROR", {"Not in a room"});
+    } else if (parsed.size() < command.minParams) {
+        reply(session, "ERROR", {command.paramError});
+    } else {
+        (this->*command.handle)(parsed, session);
+        if (command.changesRoom) {
+            markRoomDirty(session.currentRoomId);
+        }
+    }
+}
+
+void ServerShard::handleRegister(const ProtocolMessageView& parsed, ClientSession& session) {
+    // Hashing runs on a worker; the reply is sent by completeRegister once
+    // the account is on disk, and the shard serves other clients meanwhile
+    int clientSocket = session.socket;
+    uint64_t connectionId = session.connectionId;
+    std::string username(parsed[0]);
+    std::string password(parsed[1]);
+    bool queued = authWorkers.submit([this, clientSocket, connectionId, username, password]() {
+        auto onDurable = [this, clientSocket, connectionId](bool saved) {
+            std::string error = saved ? std::string() : ErrorMessages::ACCOUNT_NOT_SAVED;
+            post([clientSocket, connectionId, error](ServerShard& shard) {
+                shard.completeRegister(clientSocket, connectionId, error);
+            });
+        };
+        if (!authManager.canSaveUsers()) {
+            onDurable(false);
+        } else if (!authManager.registerUser(username, password, onDurable)) {
+            post([clientSocket, connectionId](ServerShard& shard) {
+                shard.completeRegister(clientSocket, connectionId, ErrorMessages::USERNAME_TAKEN);
+            });
+        }
+    });
+    if (queued) {
+        session.awaitingReply = true;
+    } else {
+        reply(session, "ERROR", {ErrorMessages::SERVER_BUSY});
+    }
+}
+
+void ServerShard::completeRegister(int clientSocket, uint64_t connectionId, const std::string& error) {
+    auto clientIt = clients.find(clientSocket);
+    if (clientIt == clients.end() || clientIt->second.connectionId != connectionId) {
+        return;
+    }
+    ClientSession& session = clientIt->second;
+    session.awaitingReply = false;
+    if (error.empty()) {
+        reply(session, "OK", {SuccessMessages::REGISTRATION_SUCCESS});
+    } else {
+        reply(session, "ERROR", {error});
+    }
+    serviceClient(clientSocket);
+}
+
+void ServerShard::handleLogin(const ProtocolMessageView& parsed, ClientSession& session) {
+    int clientSocket = session.socket;
+    uint64_t connectionId = session.connectionId;
+    std::string username(parsed[0]);
+    std::string password(parsed[1]);
+    bool queued = authWorkers.submit([this, clientSocket, connectionId, username, password]() {
+        PlayerId playerId = authManager.login(username, password);
+        post([clientSocket, connectionId, username, playerId](ServerShard& shard) {
+            shard.completeLogin(clientSocket, connectionId, username, playerId);
+        });
+    });
+    if (queued) {
+        session.awaitingReply = true;
+    } else {
+        reply(session, "ERROR", {ErrorMessages::SERVER_BUSY});
+    }
+}
+
+void ServerShard::completeLogin(int clientSocket, uint64_t connectionId, std::string username, PlayerId playerId) {
+    auto clientIt = clients.find(clientSocket);
+    if (clientIt == clients.end() || clientIt->second.connectionId != connectionId) {
+        return;
+    }
+    ClientSession& session = clientIt->second;
+    session.awaitingReply = false;
+    if (playerId != INVALID_PLAYER_ID) {
+        unbindPlayer(session);
+        session.username = std::move(username);
+        session.playerId = playerId;
+        session.authenticated = true;
+        bindPlayer(session);
+        revokeResumeToken(session);
+        session.resumeToken = sessionDirectory.issue(index);
+        socketsByToken[session.resumeToken] = clientSocket;
+        markSessionsDirty(session.currentRoomId);
+        reply(session, "OK", {SuccessMessages::LOGIN_SUCCESS, session.resumeToken});
+    } else {
+        reply(session, "ERROR", {ErrorMessages::INVALID_CREDENTIALS});
+    }
+    serviceClient(clientSocket);
+}
+
+void ServerShard::handleCreateRoom(const ProtocolMessageView& parsed, ClientSession& session) {
+    std::string roomName(parsed[1]);
+    RoomKind kind = RoomKind::STANDARD;
+    if (parsed.size() >= 3) {
+        if (parsed[2] == "ARENA") {
+            kind = RoomKind::ARENA;
+        } else if (parsed[2] != "STANDARD") {
+            reply(session, "ERROR", {"Invalid room type"});
+            return;
+        }
+    }
+    int roomId = roomManager.createRoom(roomName, session.playerId, kind);
+    if (roomId > 0) {
+        session.currentRoomId = roomId;
+        markSessionsDirty(roomId);
+        reply(session, "OK", {SuccessMessages::ROOM_CREATED, std::to_string(roomId)});
+    } else {
+        reply(session, "ERROR", {"Failed to create room"});
+    }
+}
+
+void ServerShard::handleJoinRoom(const ProtocolMessageView& parsed, ClientSession& session) {
+    int roomId = -1;
+    if (!parseIntField(parsed[1], roomId)) {
+        reply(session, "ERROR", {"Invalid join room parameters"});
+        return;
+    }
+    int owner = ownerOf(roomId);
+    if (owner != index) {
+        if (roomManager.isUserInRoom(session.playerId)) {
+            reply(session, "ERROR", {"User is already in a room"});
+            return;
+        }
+        // The room lives on another shard: move this client there and replay the join
+        session.migrateTo = owner;
+        session.pendingMessage.clear();
+        MessageAppender message(session.pendingMessage, parsed.command);
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            message.add(parsed[i]);
+        }
+        return;
+    }
+    JoinRoomResult joinResult = roomManager.joinRoom(roomId, session.playerId);
+    if (joinResult == JoinRoomResult::SUCCESS) {
+        session.currentRoomId = roomId;
+        markSessionsDirty(roomId);
+        reply(session, "OK", {SuccessMessages::ROOM_JOINED});
+    } else if (joinResult == JoinRoomResult::ROOM_NOT_FOUND) {
+        reply(session, "ERROR", {ErrorMessages::ROOM_NOT_FOUND});
+    } else if (joinResult == JoinRoomResult::ROOM_FULL) {
+        reply(session, "ERROR", {ErrorMessages::ROOM_FULL});
+    } else if (joinResult == JoinRoomResult::GAME_IN_PROGRESS) {
+        reply(session, "ERROR", {ErrorMessages::GAME_ALREADY_STARTED});
+    } else if (joinResult == JoinRoomResult::USER_ALREADY_IN_ROOM) {
+        reply(session, "ERROR", {"User is already in a room"});
+    } else if (joinResult == JoinRoomResult::USER_ALREADY_IN_THIS_ROOM) {
+        reply(session, "ERROR", {"User is already in this room"});
+    } else {
+        reply(session, "ERROR", {"Unknown join error"});
+    }
+}
+
+void ServerShard::handleBrowseRooms(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    if (shardCount == 1) {
+        replyRoomList(session, listAvailableRooms());
+        return;
+    }
+    // Gather the room lists of every shard; the reply is sent by completeBrowse
+    uint64_t browseId = nextBrowseId++;
+    pendingBrowses[browseId] = {session.socket, session.connectionId, shardCount, {}};
+    session.awaitingReply = true;
+    completeBrowse(browseId, listAvailableRooms());
+    for (ServerShard* peer : peers) {
+        if (peer == this) continue;
+        ServerShard* origin = this;
+        peer->post([origin, browseId](ServerShard& shard) {
+            auto rooms = shard.listAvailableRooms();
+            origin->post([browseId, rooms](ServerShard& self) { self.completeBrowse(browseId, rooms); });
+        });
+    }
+}
+
+void ServerShard::handleStartGame(const ProtocolMessageView& parsed, ClientSession& session) {
+    int questionCount = 10;
+    if (parsed.size() >= 3 && !parseIntField(parsed[2], questionCount)) {
+        reply(session, "ERROR", {"Invalid start game parameters"});
+        return;
+    }
+    std::string result = gameEngine.startGame(session.currentRoomId, session.playerId, questionCount);
+    // Everyone starts on the same question: send it to all players in one batch
+    if (result.rfind("GAME_STARTED", 0) == 0) {
+        scheduleGameTimer(session.currentRoomId);
+        auto players = roomManager.getRoomPlayers(session.currentRoomId);
+        QuestionFrame frame;
+        if (gameEngine.getCurrentQuestion(session.currentRoomId, session.playerId, frame).empty()) {
+            DEBUG_LOG(LogLevel::DEBUG, "Broadcasting " + *frame.position + " to room " + std::to_string(session.currentRoomId));
+            broadcastSegments(players, {responsePrefix, frame.position, frame.question->textSegment,
+                                        std::make_shared<const std::string>(std::to_string(frame.secondsLeft)),
+                                        frame.question->optionsSegment});
+        }
+        for (PlayerId player : players) {
+            scheduleQuestionTimer(session.currentRoomId, player);
+        }
+    }
+    reply(session, "GAME_RESPONSE", {result});
+}
+
+void ServerShard::handleEndGame(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    std::string result = gameEngine.endGame(session.currentRoomId, session.playerId);
+    if (result.rfind("GAME_ENDED", 0) == 0) {
+        cancelGameTimer(session.currentRoomId);
+    }
+    reply(session, "GAME_RESPONSE", {result});
+}
+
+void ServerShard::handleGetCurrentQuestion(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    QuestionFrame frame;
+    std::string error = gameEngine.getCurrentQuestion(session.currentRoomId, session.playerId, frame);
+    if (!error.empty()) {
+        reply(session, "GAME_RESPONSE", {error});
+        return;
+    }
+    scheduleQuestionTimer(session.currentRoomId, session.playerId);
+    queueQuestion(session, frame);
+}
+
+void ServerShard::handleSubmitAnswer(const ProtocolMessageView& parsed, ClientSession& session) {
+    int answerIndex = 0;
+    if (!parseIntField(parsed[2], answerIndex)) {
+        reply(session, "ERROR", {"Invalid submit answer parameters"});
+        return;
+    }
+    std::string result = gameEngine.submitAnswer(session.currentRoomId, session.playerId, answerIndex);
+    reply(session, "GAME_RESPONSE", {result});
+    DEBUG_LOG(LogLevel::DEBUG, "SUBMIT_ANSWER: Sent feedback to " + session.username + ": '" + result + "'");
+    // Do NOT send the next question here. Client must request it after processing feedback.
+}
+
+void ServerShard::handleGetGameInfo(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    std::string result = gameEngine.getGameInfo(session.currentRoomId, session.playerId);
+    reply(session, "GAME_RESPONSE", {result});
+}
+
+void ServerShard::handleGetLeaderboard(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    std::string result = gameEngine.getLeaderboard(session.currentRoomId, session.playerId);
+    reply(session, "GAME_RESPONSE", {result});
+}
+
+void ServerShard::handleQuit(const ProtocolMessageView& /*parsed*/, ClientSession& session) {
+    // A deliberate goodbye: the session ends with the connection
+    revokeResumeToken(session);
+    markSessionsDirty(session.currentRoomId);
+    reply(session, "OK", {"Goodbye"});
+}
+
+// Attach this connection to a session that lost its socket, keeping the
+// player's room, score and question progress. No password check: holding
+// the token proves the login.
+void ServerShard::handleResume(const ProtocolMessageView& parsed, ClientSession& session) {
+    if (session.authenticated || session.currentRoomId != -1) {
+        reply(session, "ERROR", {"Already logged in"});
+        return;
+    }
+    std::string token(parsed[0]);
+    int owner = sessionDirectory.find(token);
+    if (owner == -1) {
+        reply(session, "ERROR", {ErrorMessages::SESSION_EXPIRED});
+        return;
+    }
+    if (owner != index) {
+        // The session lives on another shard: move this connection there and replay
+        session.migrateTo = owner;
+        session.pendingMessage.clear();
+        MessageAppender message(session.pendingMessage, parsed.command);
+        message.add(token);
+        return;
+    }
+
+    auto parked = parkedSessions.find(token);
+    if (parked != parkedSessions.end()) {
+        timers.cancel(parked->second.expiry);
+        session.username = std::move(parked->second.username);
+        session.playerId = parked->second.playerId;
+        session.currentRoomId = parked->second.roomId;
+        parkedSessions.erase(parked);
+    } else {
+        // The old connection may not have been noticed as dead yet: take it over
+        auto live = socketsByToken.find(token);
+        auto oldIt = (live == socketsByToken.end()) ? clients.end() : clients.find(live->second);
+        if (oldIt == clients.end() || oldIt->second.closing) {
+            reply(session, "ERROR", {ErrorMessages::SESSION_EXPIRED});
+            return;
+        }
+        ClientSession& old = oldIt->second;
+        unbindPlayer(old);
+        session.username = old.username;
+        session.playerId = old.playerId;
+        session.currentRoomId = old.currentRoomId;
+        old.authenticated = false;
+        old.currentRoomId = -1;
+        old.resumeToken.clear();
+        scheduleClose(old);
+    }
+
+    markSessionsDirty(session.currentRoomId);
+    // A room that has gone away meanwhile is not resumed into
+    if (session.currentRoomId != -1) {
+        Room* room = roomManager.getRoom(session.currentRoomId);
+        if (!room || !room->hasPlayer(session.playerId)) {
+            session.currentRoomId = -1;
+        }
+    }
+    session.authenticated = true;
+    session.resumeToken = std::move(token);
+    socketsByToken[session.resumeToken] = session.socket;
+    bindPlayer(session);
+    reply(session, "OK", {SuccessMessages::SESSION_RESUMED, std::to_string(session.currentRoomId)});
+}
@@ -0,0 +1,201 @@
+#ifndef SERVER_SHARD_H
+#define SERVER_SHARD_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <initializer_list>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "../common/protocol.h"
+#include "../common/command_table.h"
+#include "authentication.h"
+#include "room_manager.h"
+#include "question_manager.h"
+#include "game_engine.h"
+#include "client_session.h"
+#include "reactor.h"
+#include "timer_wheel.h"
+#include "worker_pool.h"
+#include "session_directory.h"
+#include "game_snapshot.h"
+
+// One event loop thread of the server. Each shard owns its connections,
+// its rooms and the games running in them, so in-room commands run without
+// locks. A room lives on shard (roomId - 1) % shardCount; clients joining
+// a room on another shard are handed over to it, and shards otherwise talk
+// only by posting tasks to each other's mailboxes.
+class ServerShard {
+public:
+    using Task = std::function<void(ServerShard&)>;
+
+    ServerShard(int index, int shardCount, ReactorBackend backend,
+                AuthenticationManager& authManager, QuestionManager& questionManager,
+                WorkerPool& authWorkers, SessionDirectory& sessionDirectory);
+    ~ServerShard();
+
+    bool init();
+    void setPeers(const std::vector<ServerShard*>& shards);
+    bool setListener(int listenSocket);
+
+    // Thread-safe: queue a task to run on this shard's thread
+    void post(Task task);
+    void run();
+    void stop();
+
+    int getIndex() const { return index; }
+    // Shard that owns a room
+    int ownerOf(int roomId) const;
+    // Enforce GameConstants::QUESTION_TIME_LIMIT_SECONDS on every question; call before run()
+    void enableQuestionDeadlines();
+    // Most players an ARENA room accepts; call before run()
+    void setArenaCapacity(int capacity);
+    // How long a dropped session can be resumed; 0 ends it at once. Call before run()
+    void setResumeGrace(int seconds);
+    // Keep the store updated with this shard's rooms, encoding the ones that
+    // changed every interval. Call before run() and before restoreRoom()
+    void enableSnapshots(GameSnapshotStore& store, int intervalMs);
+    // Rebuild a room and its game, or the resumable sessions of players in
+    // this shard's rooms, from snapshot records. Call before run(), rooms first
+    bool restoreRoom(int roomId, const std::string& record);
+    void restoreSessions(const std::string& record);
+    // Encodes every changed room into the store at once; call before run() or
+    // once the shard has stopped
+    void saveSnapshot();
+
+private:
+    struct CommandHandler {
+        void (ServerShard::*handle)(const ProtocolMessageView& parsed, ClientSession& session);
+        bool requiresAuth;
+        bool requiresRoom;
+        size_t minParams;
+        const char* paramError;   // reply when fewer than minParams are given
+        bool changesRoom;         // the session's room must be snapshotted again
+    };
+    static const CommandHandler commandHandlers[];
+
+    enum class ClientStatus {
+        OPEN,
+        CLOSED,
+        MIGRATED
+    };
+
+    // A session whose socket dropped, kept until RESUME or the grace window ends
+    struct ParkedSession {
+        std::string username;
+        PlayerId playerId;
+        int roomId;
+        TimerId expiry;
+    };
+
+    struct PendingBrowse {
+        int socket;
+        uint64_t connectionId;
+        int remainingShards;
+        std::vector<std::pair<int, std::string>> rooms;
+    };
+
+    int index;
+    int shardCount;
+    std::unique_ptr<Reactor> reactor;
+    int wakeupFd;
+    int listenSocket;
+    int nextAcceptShard;
+    std::atomic<bool> running;
+
+    std::mutex mailboxMutex;
+    std::vector<Task> mailbox;
+    std::vector<ServerShard*> peers;
+
+    AuthenticationManager& authManager;
+    QuestionManager& questionManager;
+    WorkerPool& authWorkers;   // runs REGISTER/LOGIN password hashing
+    SessionDirectory& sessionDirectory;   // resume token -> shard, shared by all shards
+    RoomManager roomManager;
+    GameEngine gameEngine;
+
+    std::unordered_map<int, ClientSession> clients;
+    std::unordered_map<PlayerId, int> socketsByPlayer;   // logged-in users on this shard
+    std::unordered_map<std::string, int> socketsByToken;   // resume token -> socket of a connected session
+    std::unordered_map<std::string, ParkedSession> parkedSessions;   // by resume token
+    int resumeGraceSeconds;
+    std::unordered_map<uint64_t, PendingBrowse> pendingBrowses;
+    uint64_t nextBrowseId;
+    std::vector<std::pair<int, uint64_t>> closeQueue;   // (socket, connectionId) to remove
+    TimerWheel timers;
+    std::unordered_map<int, TimerId> gameTimers;   // roomId -> end-of-game timer
+    std::unordered_map<PlayerId, TimerId> questionTimers;   // deadline of each player's current question
+    GameSnapshotStore* snapshotStore;   // nullptr when snapshots are off
+    std::chrono::milliseconds snapshotInterval;
+    std::unordered_set<int> dirtyRooms;   // rooms changed since they were last encoded
+    bool sessionsDirty;   // a session in one of the rooms was added, ended or re-issued
+    OutputStats outputStats;
+    std::shared_ptr<const std::string> responsePrefix;   // "GAME_RESPONSE|", shared by broadcasts
+    std::vector<std::pair<ClientSession*, bool>> broadcastBatch;   // recipients and whether their queue was empty
+
+    std::vector<std::pair<int, std::string>> listAvailableRooms() const;
+
+    void acceptClients();
+    void adoptConnection(int clientSocket);
+    void adoptClient(ClientSession session);
+    void migrateClient(int clientSocket);
+    void removeClient(int clientSocket);
+    void bindPlayer(ClientSession& session);
+    void unbindPlayer(const ClientSession& session);
+    void revokeResumeToken(ClientSession& session);
+    void parkSession(const std::string& token, const std::string& username, PlayerId playerId, int roomId);
+    void expireParkedSession(const std::string& token);
+    void scheduleClose(ClientSession& session);
+    void closePendingClients();
+    void drainMailbox();
+
+    void serviceClient(int clientSocket, unsigned events = EVENT_READ);
+    ClientStatus readFromClient(ClientSession& session);
+    bool handleMessage(ClientSession& session, std::string_view msg);
+    void processCommand(const ProtocolMessageView& parsed, ClientSession& session);
+    void scheduleGameTimer(int roomId);
+    void cancelGameTimer(int roomId);
+    void finishExpiredGame(int roomId);
+    void scheduleQuestionTimer(int roomId, PlayerId player);
+    void markRoomDirty(int roomId);
+    void markSessionsDirty(int roomId);
+    void scheduleSnapshot(std::chrono::milliseconds delay);
+    bool encodeDirtyRooms(std::chrono::steady_clock::time_point deadline);
+    void encodeSessions();
+
+    void handleRegister(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleLogin(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleCreateRoom(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleJoinRoom(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleBrowseRooms(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleStartGame(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleEndGame(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleGetCurrentQuestion(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleSubmitAnswer(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleGetGameInfo(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleGetLeaderboard(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleQuit(const ProtocolMessageView& parsed, ClientSession& session);
+    void handleResume(const ProtocolMessageView& parsed, ClientSession& session);
+    void completeBrowse(uint64_t browseId, const std::vector<std::pair<int, std::string>>& rooms);
+    // error is empty on success
+    void completeRegister(int clientSocket, uint64_t connectionId, const std::string& error);
+    void completeLogin(int clientSocket, uint64_t connectionId, std::string username, PlayerId playerId);
+
+    void reply(ClientSession& session, std::string_view command, std::initializer_list<std::string_view> params);
+    void replyRoomList(ClientSession& session, const std::vector<std::pair<int, std::string>>& rooms);
+    void queueToClient(ClientSession& session, std::string_view message);
+    void queueSharedToClient(ClientSession& session, const std::shared_ptr<const std::string>& frame);
+    void commitOutput(ClientSession& session, bool wasEmpty);
+    void flushClient(ClientSession& session);
+    void sendToClient(PlayerId player, const std::string& message);
+    void broadcastToRoom(int roomId, const std::vector<PlayerId>& players, const std::string& message);
+    void broadcastSegments(const std::vector<PlayerId>& players,
+                           std::initializer_list<std::shared_ptr<const std::string>> segments);
+    void queueQuestion(ClientSession& session, const QuestionFrame& frame);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "session_directory.h"
+#include <random>
+#include <cerrno>
+#include <cstdint>
+
+#include <sys/random.h>
+
+namespace {
+    const size_t TOKEN_BYTES = 16;
+
+    std::string randomToken() {
+        static const char digits[] = "0123456789abcdef";
+        uint8_t bytes[TOKEN_BYTES];
+        size_t filled = 0;
+        while (filled < sizeof(bytes)) {
+            ssize_t got = getrandom(bytes + filled, sizeof(bytes) - filled, 0);
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                std::random_device device;
+                for (; filled < sizeof(bytes); ++filled) bytes[filled] = static_cast<uint8_t>(device());
+                break;
+            }
+            filled += static_cast<size_t>(got);
+        }
+        std::string token(TOKEN_BYTES * 2, '0');
+        for (size_t i = 0; i < TOKEN_BYTES; ++i) {
+            token[2 * i] = digits[bytes[i] >> 4];
+            token[2 * i + 1] = digits[bytes[i] & 0x0f];
+        }
+        return token;
+    }
+}
+
+std::string SessionDirectory::issue(int shard) {
+    std::string token = randomToken();
+    std::lock_guard<std::mutex> lock(mutex);
+    shards[token] = shard;
+    return token;
+}
+
+int SessionDirectory::find(const std::string& token) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = shards.find(token);
+    return it == shards.end() ? -1 : it->second;
+}
+
+void SessionDirectory::move(const std::string& token, int shard) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = shards.find(token);
+    if (it != shards.end()) {
+        it->second = shard;
+    }
+}
+
+void SessionDirectory::restore(const std::string& token, int shard) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shards[token] = shard;
+}
+
+void SessionDirectory::revoke(const std::string& token) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shards.erase(token);
+}
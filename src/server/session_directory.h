@@ -0,0 +1,28 @@
+#ifndef SESSION_DIRECTORY_H
+#define SESSION_DIRECTORY_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+// Resume tokens of logged-in sessions, and the shard that currently holds
+// each one. Shared by all shards: LOGIN issues a token, a session moving to
+// another shard updates its entry, and RESUME looks up where to send a
+// reconnecting client.
+class SessionDirectory {
+public:
+    // A new random token, held by shard
+    std::string issue(int shard);
+    // Shard holding token, or -1 if it is unknown or expired
+    int find(const std::string& token) const;
+    void move(const std::string& token, int shard);
+    // Registers a token issued before a restart, held by shard
+    void restore(const std::string& token, int shard);
+    void revoke(const std::string& token);
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, int> shards;
+};
+
+#endif
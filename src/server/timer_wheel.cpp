@@ -0,0 +1,121 @@
+#include "timer_wheel.h"
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tickLength(tick), origin(start), currentTick(0), nextTimerId(1), upperLevelEntries(0) {
+}
+
+TimerId TimerWheel::schedule(Clock::time_point deadline, Callback callback) {
+    // Round up so a timer never fires before its deadline
+    auto offset = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - origin);
+    uint64_t expiryTick = currentTick + 1;
+    if (offset.count() > 0) {
+        uint64_t ticks = (static_cast<uint64_t>(offset.count()) + tickLength.count() - 1) / tickLength.count();
+        if (ticks > expiryTick) {
+            expiryTick = ticks;
+        }
+    }
+    TimerId id = nextTimerId++;
+    timers.emplace(id, Timer{expiryTick, std::move(callback)});
+    place(id, expiryTick);
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    return timers.erase(id) > 0;
+}
+
+void TimerWheel::place(TimerId id, uint64_t expiryTick) {
+    uint64_t delta = expiryTick - currentTick;
+    for (int level = 0; level < LEVELS; ++level) {
+        uint64_t span = uint64_t(1) << (SLOT_BITS * (level + 1));
+        if (delta < span || level == LEVELS - 1) {
+            if (delta >= span) {
+                // Beyond the top level: park in the furthest slot and re-place from there
+                expiryTick = currentTick + span - 1;
+            }
+            wheel[level][(expiryTick >> (SLOT_BITS * level)) & SLOT_MASK].push_back(id);
+            if (level > 0) {
+                upperLevelEntries++;
+            }
+            return;
+        }
+    }
+}
+
+// Moves the timers of the current slot on this level down the hierarchy
+void TimerWheel::cascade(int level) {
+    std::vector<TimerId> entries;
+    entries.swap(wheel[level][(currentTick >> (SLOT_BITS * level)) & SLOT_MASK]);
+    upperLevelEntries -= entries.size();
+    for (TimerId id : entries) {
+        auto it = timers.find(id);
+        if (it != timers.end()) {
+            place(id, it->second.expiryTick);
+        }
+    }
+}
+
+void TimerWheel::advance(Clock::time_point now) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - origin);
+    if (elapsed.count() < 0) {
+        return;
+    }
+    uint64_t targetTick = static_cast<uint64_t>(elapsed.count()) / tickLength.count();
+    while (currentTick < targetTick) {
+        if (timers.empty()) {
+            // Nothing can fire: jump ahead instead of walking every tick
+            currentTick = targetTick;
+            break;
+        }
+        ++currentTick;
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((currentTick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        std::vector<TimerId> due;
+        due.swap(wheel[0][currentTick & SLOT_MASK]);
+        for (TimerId id : due) {
+            auto it = timers.find(id);
+            if (it == timers.end()) {
+                continue;
+            }
+            if (it->second.expiryTick > currentTick) {
+                place(id, it->second.expiryTick);
+                continue;
+            }
+            Callback callback = std::move(it->second.callback);
+            timers.erase(it);
+            callback();
+        }
+    }
+}
+
+int TimerWheel::millisecondsUntilNext(Clock::time_point now) const {
+    if (timers.empty()) {
+        return -1;
+    }
+    // Next occupied slot on the lowest level, or the next cascade if only
+    // higher levels hold timers
+    uint64_t nextTick = 0;
+    for (uint64_t k = 1; k <= SLOTS; ++k) {
+        if (!wheel[0][(currentTick + k) & SLOT_MASK].empty()) {
+            nextTick = currentTick + k;
+            break;
+        }
+    }
+    if (upperLevelEntries > 0) {
+        uint64_t cascadeTick = (currentTick | SLOT_MASK) + 1;
+        if (nextTick == 0 || cascadeTick < nextTick) {
+            nextTick = cascadeTick;
+        }
+    }
+    if (nextTick == 0) {
+        return -1;
+    }
+    auto wakeAt = origin + tickLength * static_cast<int64_t>(nextTick);
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - now).count();
+    return wait < 0 ? 0 : static_cast<int>(wait) + 1;
+}
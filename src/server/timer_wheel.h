@@ -0,0 +1,64 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+typedef uint64_t TimerId;
+
+// Hierarchical timing wheel with four levels of 64 slots. Scheduling and
+// cancelling are O(1); each tick touches one slot, and timers far in the
+// future move down a level when their slot comes round. Not thread-safe:
+// each shard owns one and drives it from its event loop.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10),
+                        Clock::time_point start = Clock::now());
+
+    // Runs the callback on the first advance() at or after the deadline
+    TimerId schedule(Clock::time_point deadline, Callback callback);
+    bool cancel(TimerId id);
+
+    // Fires every timer that is due by now
+    void advance(Clock::time_point now);
+
+    // Milliseconds the event loop may sleep before the next advance(), or
+    // -1 when nothing is scheduled
+    int millisecondsUntilNext(Clock::time_point now) const;
+
+    size_t size() const { return timers.size(); }
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const uint64_t SLOTS = uint64_t(1) << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+
+    struct Timer {
+        uint64_t expiryTick;
+        Callback callback;
+    };
+
+    std::chrono::milliseconds tickLength;
+    Clock::time_point origin;
+    uint64_t currentTick;
+    TimerId nextTimerId;
+
+    // Cancelled timers are only erased from the map; their slot entries are
+    // skipped when the slot is processed
+    std::unordered_map<TimerId, Timer> timers;
+    std::vector<TimerId> wheel[LEVELS][SLOTS];
+    size_t upperLevelEntries;
+
+    void place(TimerId id, uint64_t expiryTick);
+    void cascade(int level);
+};
+
+#endif
@@ -0,0 +1,343 @@
+#include "user_log.h"
+#include "durable_file.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    const uint64_t COMPACTION_THRESHOLD_BYTES = 4 * 1024 * 1024;
+    const std::chrono::seconds WRITE_RETRY_DELAY(1);
+
+    // "username password roomId score isAdmin", the users.txt line format
+    std::string formatUser(const User& user) {
+        return user.getUsername() + " " + user.getPassword() + " " + std::to_string(user.getCurrentRoomId()) + " "
+               + std::to_string(user.getScore()) + " " + (user.getIsAdmin() ? "1" : "0");
+    }
+
+    bool parseUser(const std::string& line, User& user) {
+        std::istringstream iss(line);
+        std::string username, password;
+        int currentRoomId, score;
+        bool isAdmin;
+        if (!(iss >> username >> password >> currentRoomId >> score >> isAdmin)) {
+            return false;
+        }
+        user = User(username, password);
+        user.setCurrentRoomId(currentRoomId);
+        user.setScore(score);
+        user.setIsAdmin(isAdmin);
+        return true;
+    }
+
+    // Log record: 8 hex digits of CRC32 over the payload, a space, the payload
+    void appendRecord(std::string& out, const User& user) {
+        std::string payload = formatUser(user);
+        char crc[9];
+        std::snprintf(crc, sizeof(crc), "%08x", DurableFile::crc32(payload.data(), payload.size()));
+        out.append(crc, 8);
+        out += ' ';
+        out += payload;
+        out += '\n';
+    }
+
+    bool parseRecord(const std::string& line, User& user) {
+        if (line.size() < 10 || line[8] != ' ') {
+            return false;
+        }
+        char* end = nullptr;
+        unsigned long crc = std::strtoul(line.substr(0, 8).c_str(), &end, 16);
+        if (*end != '\0' || crc != DurableFile::crc32(line.data() + 9, line.size() - 9)) {
+            return false;
+        }
+        return parseUser(line.substr(9), user);
+    }
+
+    bool fileExists(const std::string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+}
+
+UserLog::UserLog(const std::string& snapshotFile)
+    : snapshotPath(snapshotFile), logPath(snapshotFile + ".log"), sealedPath(snapshotFile + ".log.1"),
+      logFd(-1), logBytes(0), appendedSequence(0), durableSequence(0), accepting(false), stopping(false), compacting(false) {
+}
+
+UserLog::~UserLog() {
+    close();
+}
+
+bool UserLog::replayLog(const std::string& path, const std::function<void(const User&)>& apply, bool truncateTail) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    uint64_t goodBytes = 0;
+    size_t records = 0;
+    User user;
+    while (std::getline(file, line)) {
+        if (file.eof() || !parseRecord(line, user)) {
+            // A torn write at the tail after a crash, or damage: nothing after it is trusted
+            std::cerr << "User log " << path << ": damaged record at byte " << goodBytes
+                      << ", ignoring the rest of the log." << std::endl;
+            if (truncateTail && ::truncate(path.c_str(), static_cast<off_t>(goodBytes)) != 0) {
+                std::cerr << "Could not truncate " << path << std::endl;
+            }
+            break;
+        }
+        apply(user);
+        goodBytes += line.size() + 1;
+        ++records;
+    }
+    std::cout << "Replayed " << records << " user records from " << path << "." << std::endl;
+    return true;
+}
+
+bool UserLog::recover(const std::function<void(const User&)>& apply) {
+    std::ifstream snapshot(snapshotPath);
+    if (snapshot.is_open()) {
+        std::string line;
+        User user;
+        while (std::getline(snapshot, line)) {
+            if (parseUser(line, user)) {
+                apply(user);
+            }
+        }
+    } else {
+        std::cout << "No existing user file found. Starting fresh." << std::endl;
+    }
+    snapshot.close();
+
+    // A sealed log means the server stopped while merging it; finish that first
+    bool sealed = replayLog(sealedPath, apply, true);
+    replayLog(logPath, apply, true);
+    if (sealed && !compact()) {
+        std::cerr << "Could not merge " << sealedPath << " into " << snapshotPath << std::endl;
+    }
+
+    logFd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (logFd == -1) {
+        std::cerr << "Cannot open user log " << logPath << " for writing." << std::endl;
+        return false;
+    }
+    struct stat info;
+    logBytes = (fstat(logFd, &info) == 0) ? static_cast<uint64_t>(info.st_size) : 0;
+    accepting = true;
+    writer = std::thread(&UserLog::writerLoop, this);
+    return true;
+}
+
+void UserLog::append(const User& user, DurableCallback onDurable) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (accepting) {
+            appendRecord(pending.bytes, user);
+            if (onDurable) {
+                pending.callbacks.push_back(std::move(onDurable));
+            }
+            pending.lastSequence = ++appendedSequence;
+            onDurable = nullptr;
+        }
+    }
+    if (onDurable) {
+        onDurable(false);
+        return;
+    }
+    wakeWriter.notify_one();
+}
+
+bool UserLog::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return accepting;
+}
+
+bool UserLog::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = appendedSequence;
+    durable.wait(lock, [this, target] { return durableSequence >= target || !accepting; });
+    return durableSequence >= target;
+}
+
+// Everything queued while the previous batch was being synced goes out in
+// the next write and shares its fsync
+void UserLog::writerLoop() {
+    for (;;) {
+        Batch batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeWriter.wait(lock, [this] { return stopping || !pending.bytes.empty(); });
+            if (pending.bytes.empty()) {
+                accepting = false;   // stopping with nothing left
+                return;
+            }
+            std::swap(batch, pending);
+        }
+        // A failed batch is retried until it is on disk; nothing after it is
+        // reported durable meanwhile
+        bool written = writeBatch(batch);
+        while (!written) {
+            std::cerr << "User log write failed: " << std::strerror(errno) << "; retrying." << std::endl;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (wakeWriter.wait_for(lock, WRITE_RETRY_DELAY, [this] { return stopping; })) {
+                    break;
+                }
+            }
+            // Cut off any part of the batch that did reach the file: recovery
+            // stops at a torn record and would drop everything after it
+            written = ftruncate(logFd, static_cast<off_t>(logBytes)) == 0 && writeBatch(batch);
+        }
+        if (!written) {
+            abandon(batch);
+            return;
+        }
+        for (auto& callback : batch.callbacks) {
+            callback(true);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            durableSequence = batch.lastSequence;
+        }
+        durable.notify_all();
+
+        logBytes += batch.bytes.size();
+        if (logBytes >= COMPACTION_THRESHOLD_BYTES && !compacting.load()) {
+            startCompaction();
+        }
+    }
+}
+
+bool UserLog::writeBatch(const Batch& batch) {
+    return DurableFile::writeAll(logFd, batch.bytes.data(), batch.bytes.size()) && fdatasync(logFd) == 0;
+}
+
+// Closing while the disk still fails: the batch and everything queued behind
+// it are reported lost, and later appends are refused
+void UserLog::abandon(Batch& batch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        accepting = false;
+        for (auto& callback : pending.callbacks) {
+            batch.callbacks.push_back(std::move(callback));
+        }
+        pending = Batch();
+    }
+    std::cerr << "User log closed with unsaved changes." << std::endl;
+    for (auto& callback : batch.callbacks) {
+        callback(false);
+    }
+    durable.notify_all();
+    if (ftruncate(logFd, static_cast<off_t>(logBytes)) != 0) {
+        std::cerr << "Could not truncate " << logPath << std::endl;
+    }
+}
+
+// Seal the current log and let a background thread merge it into the
+// snapshot; new records go to a fresh log meanwhile. Writer thread only.
+void UserLog::startCompaction() {
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    if (fileExists(sealedPath)) {
+        return;   // the last merge failed; keep appending to the current log
+    }
+    if (std::rename(logPath.c_str(), sealedPath.c_str()) != 0) {
+        return;
+    }
+    int freshFd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (freshFd == -1) {
+        std::rename(sealedPath.c_str(), logPath.c_str());
+        return;
+    }
+    DurableFile::syncDirectoryOf(logPath);
+    ::close(logFd);
+    logFd = freshFd;
+    logBytes = 0;
+    compacting.store(true);
+    compactor = std::thread([this] {
+        if (!compact()) {
+            std::cerr << "Could not merge " << sealedPath << " into " << snapshotPath << std::endl;
+        }
+        compacting.store(false);
+    });
+}
+
+// Writes snapshot + sealed log as a new snapshot, then drops the sealed log
+bool UserLog::compact() {
+    std::map<std::string, User> merged;
+    auto collect = [&merged](const User& user) { merged[user.getUsername()] = user; };
+    std::ifstream snapshot(snapshotPath);
+    std::string line;
+    User user;
+    while (std::getline(snapshot, line)) {
+        if (parseUser(line, user)) {
+            collect(user);
+        }
+    }
+    snapshot.close();
+    if (fileExists(sealedPath)) {
+        replayLog(sealedPath, collect, false);
+    }
+
+    std::string tempPath = snapshotPath + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    std::string bytes;
+    bool ok = true;
+    for (const auto& pair : merged) {
+        bytes += formatUser(pair.second);
+        bytes += '\n';
+        if (bytes.size() >= 64 * 1024) {
+            ok = ok && DurableFile::writeAll(fd, bytes.data(), bytes.size());
+            bytes.clear();
+        }
+    }
+    ok = ok && DurableFile::writeAll(fd, bytes.data(), bytes.size()) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || std::rename(tempPath.c_str(), snapshotPath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    DurableFile::syncDirectoryOf(snapshotPath);
+    std::remove(sealedPath.c_str());
+    DurableFile::syncDirectoryOf(sealedPath);
+    return true;
+}
+
+void UserLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!writer.joinable()) {
+            return;
+        }
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join();
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+    ::close(logFd);
+    logFd = -1;
+
+    // Leave a complete snapshot and an empty log behind
+    if (logBytes > 0 && !fileExists(sealedPath) && std::rename(logPath.c_str(), sealedPath.c_str()) == 0) {
+        if (compact()) {
+            ::close(::open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef USER_LOG_H
+#define USER_LOG_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "../common/user.h"
+
+// Durable storage for user accounts: a snapshot file (the users.txt
+// format) plus an append-only log of changed user records.
+//
+// Appends are handed to a writer thread that writes and fsyncs them in
+// batches (group commit), so callers never touch the disk. Every log
+// record carries a CRC32; recovery replays the snapshot and then the log,
+// and cuts the log at the first torn or damaged record. Once the log grows
+// past a threshold it is sealed and merged into a new snapshot in the
+// background.
+class UserLog {
+public:
+    // Called with true once the record is on disk, or false if it never
+    // will be: the log could not be opened, or it was closed while the disk
+    // kept failing
+    typedef std::function<void(bool durable)> DurableCallback;
+
+    explicit UserLog(const std::string& snapshotFile);
+    ~UserLog();
+
+    // Replays the snapshot and logs through apply, then starts the writer.
+    // Returns false if the log could not be opened for writing.
+    bool recover(const std::function<void(const User&)>& apply);
+    // Queues the user's current record. onDurable, if set, runs on the
+    // writer thread once the record is on disk. Without a writer the record
+    // is dropped and onDurable(false) runs at once.
+    void append(const User& user, DurableCallback onDurable = nullptr);
+    // True while appends are accepted
+    bool isOpen() const;
+    // Blocks until everything appended so far is on disk; false if some of
+    // it never will be
+    bool flush();
+    // Flushes, stops the writer and folds the log into the snapshot
+    void close();
+
+private:
+    struct Batch {
+        std::string bytes;
+        std::vector<DurableCallback> callbacks;
+        uint64_t lastSequence = 0;
+    };
+
+    std::string snapshotPath;
+    std::string logPath;
+    std::string sealedPath;   // a log being merged into the snapshot
+    int logFd;
+    uint64_t logBytes;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeWriter;
+    std::condition_variable durable;
+    Batch pending;
+    uint64_t appendedSequence;
+    uint64_t durableSequence;
+    bool accepting;   // the writer is running and takes appends
+    bool stopping;
+    std::thread writer;
+
+    std::thread compactor;
+    std::atomic<bool> compacting;
+
+    void writerLoop();
+    bool writeBatch(const Batch& batch);
+    void abandon(Batch& batch);
+    void startCompaction();
+    bool compact();
+    bool replayLog(const std::string& path, const std::function<void(const User&)>& apply, bool truncateTail);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "user_table.h"
+#include <functional>
+
+namespace {
+    const size_t INITIAL_SLOTS = 64;
+
+    uint32_t tagOf(size_t hash) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(hash) >> 32);
+    }
+}
+
+UserTable::UserTable() : slots(INITIAL_SLOTS, Slot{0, 0}) {
+}
+
+size_t UserTable::probe(const std::string& username, size_t hash) const {
+    size_t mask = slots.size() - 1;
+    uint32_t tag = tagOf(hash);
+    for (size_t position = hash & mask;; position = (position + 1) & mask) {
+        const Slot& slot = slots[position];
+        if (slot.record == 0) {
+            return position;
+        }
+        if (slot.tag == tag && records[slot.record - 1].username == username) {
+            return position;
+        }
+    }
+}
+
+User* UserTable::find(const std::string& username) {
+    const Slot& slot = slots[probe(username, std::hash<std::string>()(username))];
+    return slot.record == 0 ? nullptr : &records[slot.record - 1];
+}
+
+const User* UserTable::find(const std::string& username) const {
+    const Slot& slot = slots[probe(username, std::hash<std::string>()(username))];
+    return slot.record == 0 ? nullptr : &records[slot.record - 1];
+}
+
+bool UserTable::insert(const User& user) {
+    // Keep the load factor at or below 3/4 so probe runs stay short
+    if ((records.size() + 1) * 4 > slots.size() * 3) {
+        grow();
+    }
+    size_t hash = std::hash<std::string>()(user.username);
+    Slot& slot = slots[probe(user.username, hash)];
+    if (slot.record != 0) {
+        return false;
+    }
+    records.push_back(user);
+    slot.tag = tagOf(hash);
+    slot.record = static_cast<uint32_t>(records.size());
+    return true;
+}
+
+void UserTable::put(const User& user) {
+    if (User* existing = find(user.username)) {
+        *existing = user;
+    } else {
+        insert(user);
+    }
+}
+
+void UserTable::clear() {
+    records.clear();
+    slots.assign(INITIAL_SLOTS, Slot{0, 0});
+}
+
+void UserTable::grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(old.size() * 2, Slot{0, 0});
+    size_t mask = slots.size() - 1;
+    for (const Slot& entry : old) {
+        if (entry.record == 0) {
+            continue;
+        }
+        // Usernames are unique, so only an empty slot has to be found
+        size_t position = std::hash<std::string>()(records[entry.record - 1].username) & mask;
+        while (slots[position].record != 0) {
+            position = (position + 1) & mask;
+        }
+        slots[position] = entry;
+    }
+}
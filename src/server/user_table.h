@@ -0,0 +1,46 @@
+#ifndef USER_TABLE_H
+#define USER_TABLE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+#include "../common/user.h"
+
+// User accounts keyed by username, in an open-addressing hash table with
+// linear probing. Records live in a deque so User pointers stay valid as
+// the table grows; each probe slot holds only a 32-bit hash tag and a
+// record index, so a lookup reads a few adjacent slots and one record.
+class UserTable {
+public:
+    UserTable();
+
+    User* find(const std::string& username);
+    const User* find(const std::string& username) const;
+    // False, leaving the table unchanged, if the username is taken
+    bool insert(const User& user);
+    // Inserts or replaces the record with this username
+    void put(const User& user);
+    void clear();
+
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    // Every record, in insertion order
+    const std::deque<User>& all() const { return records; }
+
+private:
+    struct Slot {
+        uint32_t tag;      // high bits of the username hash
+        uint32_t record;   // index into records + 1; 0 marks an empty slot
+    };
+
+    std::vector<Slot> slots;   // size is a power of two
+    std::deque<User> records;
+
+    // Slot holding username, or the empty slot where it would go
+    size_t probe(const std::string& username, size_t hash) const;
+    void grow();
+};
+
+#endif
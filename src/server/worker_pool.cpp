@@ -0,0 +1,60 @@
+#include "worker_pool.h"
+
+WorkerPool::WorkerPool(size_t threadCount, size_t limit)
+    : queueLimit(limit), stopping(false) {
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+bool WorkerPool::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || jobs.size() >= queueLimit) {
+            return false;
+        }
+        if (!threads.empty()) {
+            jobs.push_back(std::move(job));
+        }
+    }
+    if (threads.empty()) {
+        job();
+        return true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::workerLoop() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
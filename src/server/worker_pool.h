@@ -0,0 +1,43 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Fixed set of threads for blocking or CPU-heavy work (password hashing)
+// that must stay off the shards' event loops. Jobs report back by posting
+// to a shard's mailbox. The queue is bounded: submit() refuses work
+// instead of letting a burst queue up without limit.
+class WorkerPool {
+public:
+    typedef std::function<void()> Job;
+
+    // With threadCount 0, submit() runs each job on the caller's thread
+    WorkerPool(size_t threadCount, size_t queueLimit);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // False if the queue is full or the pool is stopping
+    bool submit(Job job);
+    // Runs the jobs already queued, then joins the threads
+    void stop();
+
+    size_t threadCount() const { return threads.size(); }
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<Job> jobs;
+    size_t queueLimit;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void workerLoop();
+};
+
+#endif
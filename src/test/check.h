@@ -0,0 +1,23 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the regression checks run by `make test`. A failed
+// CHECK is reported and counted; the test's main returns the count.
+namespace TestCheck {
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+}
+
+#define CHECK(condition)                                                                     \
+    do {                                                                                     \
+        if (!(condition)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            ++TestCheck::failures();                                                         \
+        }                                                                                    \
+    } while (0)
+
+#endif
@@ -0,0 +1,151 @@
+// Regression checks for game snapshots: every field type survives an
+// encode/decode round trip, truncated or corrupted records are rejected
+// without reading out of bounds, and the store only loads a file whose
+// checksum holds.
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "check.h"
+#include "../server/game_snapshot.h"
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Fields {
+        uint8_t u8 = 0;
+        uint32_t u32 = 0;
+        int32_t i32 = 0;
+        int64_t i64 = 0;
+        std::string text;
+        std::string empty = "not empty";
+        Clock::time_point time;
+        uint32_t count = 0;
+    };
+
+    std::string encodeSample(Clock::time_point time) {
+        std::string record;
+        SnapshotEncoder out(record);
+        out.addU8(0xab).addU32(0xdeadbeef).addI32(-42).addI64(-1234567890123LL)
+           .addString("name|with\nbytes").addString("").addTime(time).addU32(3);
+        return record;
+    }
+
+    // Reads the fields of encodeSample in order; false as soon as one fails
+    bool decodeSample(SnapshotDecoder& in, Fields& fields) {
+        return in.readU8(fields.u8) && in.readU32(fields.u32) && in.readI32(fields.i32) && in.readI64(fields.i64)
+               && in.readString(fields.text) && in.readString(fields.empty) && in.readTime(fields.time)
+               && in.readU32(fields.count);
+    }
+
+    void checkRoundTrip() {
+        Clock::time_point now = Clock::now();
+        std::string record = encodeSample(now);
+        SnapshotDecoder in(record);
+        Fields fields;
+        CHECK(decodeSample(in, fields));
+        CHECK(in.ok() && in.atEnd());
+        CHECK(fields.u8 == 0xab);
+        CHECK(fields.u32 == 0xdeadbeef);
+        CHECK(fields.i32 == -42);
+        CHECK(fields.i64 == -1234567890123LL);
+        CHECK(fields.text == "name|with\nbytes");
+        CHECK(fields.empty.empty());
+        // Times go through wall-clock milliseconds
+        auto drift = std::chrono::duration_cast<std::chrono::milliseconds>(fields.time - now).count();
+        CHECK(drift >= -2 && drift <= 2);
+        CHECK(fields.count == 3);
+    }
+
+    void checkTruncated() {
+        std::string record = encodeSample(Clock::now());
+        for (size_t length = 0; length < record.size(); ++length) {
+            SnapshotDecoder in(record.data(), length);
+            Fields fields;
+            CHECK(!decodeSample(in, fields));
+            CHECK(!in.ok());
+            uint8_t after = 0;
+            CHECK(!in.readU8(after));   // a failure sticks
+        }
+    }
+
+    void checkCorrupted() {
+        // A string length far past the end of the record
+        std::string record;
+        SnapshotEncoder out(record);
+        out.addU32(0xfffffff0u).addU8(1);
+        SnapshotDecoder strings(record);
+        std::string text;
+        CHECK(!strings.readString(text) && !strings.ok());
+
+        // A count the remaining bytes cannot hold
+        std::string counted;
+        SnapshotEncoder countOut(counted);
+        countOut.addU32(1000000).addI32(7).addI32(8);
+        SnapshotDecoder counts(counted);
+        uint32_t count = 0;
+        CHECK(!counts.readCount(count, 8) && !counts.ok());
+        SnapshotDecoder fits(counted);
+        CHECK(fits.readCount(count, 0) && count == 1000000);
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    void writeFile(const std::string& path, const std::string& bytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << bytes;
+    }
+
+    void checkStore(const std::string& path) {
+        {
+            GameSnapshotStore store(path);
+            store.start();
+            std::vector<std::pair<int, GameSnapshotStore::Record>> changes;
+            changes.emplace_back(1, std::make_shared<const std::string>("room one"));
+            changes.emplace_back(4, std::make_shared<const std::string>(std::string("room\0four", 9)));
+            changes.emplace_back(9, std::make_shared<const std::string>("dropped below"));
+            store.update(changes);
+            changes.emplace_back(9, nullptr);
+            store.update(changes);
+            store.updateSessions(0, std::make_shared<const std::string>("sessions"));
+            store.stop();
+        }
+        GameSnapshotStore store(path);
+        std::vector<std::pair<int, std::string>> rooms;
+        std::vector<std::string> sessions;
+        CHECK(store.load(rooms, sessions));
+        CHECK(rooms.size() == 2);
+        CHECK(rooms.size() == 2 && rooms[0].first == 1 && rooms[0].second == "room one");
+        CHECK(rooms.size() == 2 && rooms[1].first == 4 && rooms[1].second == std::string("room\0four", 9));
+        CHECK(sessions.size() == 1 && sessions[0] == "sessions");
+
+        std::string good = readFile(path);
+        for (size_t position : {size_t(0), size_t(12), good.size() / 2, good.size() - 1}) {
+            std::string damaged = good;
+            damaged[position] ^= 0x40;
+            writeFile(path, damaged);
+            CHECK(!store.load(rooms, sessions));
+        }
+        writeFile(path, good.substr(0, good.size() - 3));
+        CHECK(!store.load(rooms, sessions));
+        std::remove(path.c_str());
+        CHECK(!store.load(rooms, sessions));
+    }
+}
+
+int main() {
+    checkRoundTrip();
+    checkTruncated();
+    checkCorrupted();
+    checkStore("/tmp/game_snapshot_test_" + std::to_string(getpid()) + ".snapshot");
+    return TestCheck::failures();
+}
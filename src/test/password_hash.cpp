@@ -0,0 +1,67 @@
+// Regression checks for the scrypt password hashes: the RFC 7914 test
+// vectors, and the stored hash format that verifyPassword accepts.
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "check.h"
+#include "../server/password_hash.h"
+
+namespace {
+    struct Vector {
+        const char* password;
+        const char* salt;
+        uint64_t N;
+        uint32_t r;
+        uint32_t p;
+        const char* hex;
+    };
+
+    // RFC 7914 section 12; the N = 2^20 vector is left out for its 1 GiB of memory
+    const Vector VECTORS[] = {
+        {"", "", 16, 1, 1,
+         "77d6576238657b203b19ca42c18a0497f16b4844e3074ae8dfdffa3fede21442"
+         "fcd0069ded0948f8326a753a0fc81f17e8d3e0fb2e0d3628cf35e20c38d18906"},
+        {"password", "NaCl", 1024, 8, 16,
+         "fdbabe1c9d3472007856e7190d01e9fe7c6ad7cbc8237830e77376634b373162"
+         "2eaf30d92e22a3886ff109279d9830dac727afb94a83ee6d8360cbdfa2cc0640"},
+        {"pleaseletmein", "SodiumChloride", 16384, 8, 1,
+         "7023bdcb3afd7348461c06cd81fd38ebfda8fbba904f8e3ea9b543f6545da1f2"
+         "d5432955613f0fcf62d49705242a9af9e61e85dc0d651e40dfcf017b45575887"},
+    };
+
+    std::string toHex(const std::vector<uint8_t>& bytes) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (uint8_t byte : bytes) {
+            hex += digits[byte >> 4];
+            hex += digits[byte & 0x0f];
+        }
+        return hex;
+    }
+}
+
+int main() {
+    for (const Vector& vector : VECTORS) {
+        std::vector<uint8_t> derived(64);
+        scrypt(vector.password, vector.salt, vector.N, vector.r, vector.p, derived.data(), derived.size());
+        CHECK(toHex(derived) == vector.hex);
+    }
+
+    int storedLogN = 0;
+    std::string stored = hashPassword("correct horse", PasswordHashing::MIN_LOG_N);
+    CHECK(stored.rfind("$scrypt$10$", 0) == 0);
+    CHECK(stored.find_first_of(" \t\r\n") == std::string::npos);
+    CHECK(verifyPassword("correct horse", stored, storedLogN) && storedLogN == PasswordHashing::MIN_LOG_N);
+    CHECK(!verifyPassword("correct horsf", stored, storedLogN));
+    CHECK(hashPassword("correct horse", PasswordHashing::MIN_LOG_N) != stored);   // fresh salt each time
+
+    // Legacy plaintext records, and damaged hashes that must not be trusted
+    CHECK(verifyPassword("plain", "plain", storedLogN) && storedLogN == 0);
+    CHECK(!verifyPassword("plain", "plaim", storedLogN));
+    std::string damaged = stored;
+    damaged.back() = damaged.back() == '0' ? '1' : '0';
+    CHECK(!verifyPassword("correct horse", damaged, storedLogN));
+    CHECK(!verifyPassword("x", "$scrypt$40$8$1$00$00", storedLogN));
+
+    return TestCheck::failures();
+}
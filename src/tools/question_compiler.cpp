@@ -0,0 +1,63 @@
+// Offline compiler for question banks.
+//
+// Converts a question text file (the format of data/questions.txt) into the
+// binary .qbank format that the server maps at startup:
+//
+//   ./build/question_compiler data/questions.txt data/questions.qbank
+//   ./build/server --questions=data/questions.qbank
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "../server/question_bank.h"
+#include "../server/question_manager.h"
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <questions.txt> <output.qbank>" << std::endl;
+        return 1;
+    }
+    std::string inputPath = argv[1];
+    std::string outputPath = argv[2];
+
+    std::ifstream input(inputPath);
+    if (!input.is_open()) {
+        std::cerr << "Cannot open " << inputPath << std::endl;
+        return 1;
+    }
+
+    std::vector<QuestionSource> questions;
+    std::string line;
+    size_t lineNumber = 0;
+    size_t skipped = 0;
+    QuestionSource question;
+    while (std::getline(input, line)) {
+        ++lineNumber;
+        if (line.empty()) {
+            continue;
+        }
+        if (!QuestionManager::parseQuestionLine(line, question)) {
+            std::cerr << inputPath << ":" << lineNumber << ": malformed question, skipped" << std::endl;
+            ++skipped;
+            continue;
+        }
+        if (question.correctAnswerIndex < 0 || question.correctAnswerIndex >= static_cast<int>(question.options.size())) {
+            std::cerr << inputPath << ":" << lineNumber << ": correct answer index out of range, skipped" << std::endl;
+            ++skipped;
+            continue;
+        }
+        questions.push_back(question);
+    }
+
+    std::string error;
+    if (!writeQuestionBank(outputPath, questions, error)) {
+        std::cerr << "Failed to compile " << inputPath << ": " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Compiled " << questions.size() << " questions into " << outputPath;
+    if (skipped > 0) {
+        std::cout << " (" << skipped << " skipped)";
+    }
+    std::cout << "." << std::endl;
+    return 0;
+}